@@ -20,6 +20,9 @@
 
   API you’ll use
     Init(Z16 / Z64);            // choose resolution
+    BeginAsync(Z16); Step();    // or boot without blocking loop(), Ready() when done
+    UseInt(pin);                // optional: read frames on the sensor INT pin
+    StartTask();                // optional (ESP32): a background task owns the sensor
     Run(hz);                    // update rate (Hz, 1–100)
     PrintZones();               // print grid + L/M/R averages
     PrintZonesAvg();            // print just L/M/R averages
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "LokaBus.h"
 #include "LokaMotors.h"
+#include "LokaDrive.h"
 #include "LokaMCU.h"
 #include "LokaToF.h"
 #include <Arduino.h>
@@ -0,0 +1,107 @@
+// LokaBus.cpp
+#include "LokaBus.h"
+
+LokaBus LokaI2C;
+
+LokaBus::LokaBus()
+: _wire(&Wire), _begun(false), _clockHz(0), _waiting(0)
+#if LOKA_BUS_RTOS
+  , _mutex(nullptr), _mux(portMUX_INITIALIZER_UNLOCKED)
+#endif
+{
+  _prio[BUS_TOF]   = 1;
+  _prio[BUS_IMU]   = 3;
+  _prio[BUS_LIGHT] = 2;
+  ResetStats();
+}
+
+TwoWire& LokaBus::Begin(uint32_t clockHz, TwoWire& wire) {
+  if (!_begun) {
+    _wire = &wire;
+#if LOKA_BUS_RTOS
+    _mutex = xSemaphoreCreateMutex();
+#endif
+    _wire->begin();
+    _begun = true;
+  }
+  if (clockHz > _clockHz) {
+#if LOKA_BUS_RTOS
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+#endif
+    _wire->setClock(clockHz);
+    _clockHz = clockHz;
+#if LOKA_BUS_RTOS
+    xSemaphoreGive(_mutex);
+#endif
+  }
+  return *_wire;
+}
+
+void LokaBus::Lock(LokaBusDev dev) {
+  const uint32_t t0 = micros();
+#if LOKA_BUS_RTOS
+  if (_mutex) {
+    portENTER_CRITICAL(&_mux);
+    _waiting |= (1u << dev);
+    portEXIT_CRITICAL(&_mux);
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&_mux);
+    _waiting &= ~(1u << dev);
+    portEXIT_CRITICAL(&_mux);
+  }
+#endif
+  const uint32_t now = micros();
+  LokaBusStats& s = _stats[dev];
+  const uint32_t wait = now - t0;
+  s.waitUs += wait;
+  if (wait > s.maxWaitUs) s.maxWaitUs = wait;
+  _lockUs[dev] = now;
+}
+
+void LokaBus::Unlock(LokaBusDev dev) {
+  LokaBusStats& s = _stats[dev];
+  s.busyUs += micros() - _lockUs[dev];
+  s.transfers++;
+#if LOKA_BUS_RTOS
+  if (_mutex) xSemaphoreGive(_mutex);
+#endif
+}
+
+void LokaBus::Yield(LokaBusDev dev) {
+  if (!higherWaiting_(dev)) return;
+  _stats[dev].yields++;
+  Unlock(dev);
+#if LOKA_BUS_RTOS
+  // let the waiter take the mutex even if its task has a lower RTOS priority
+  while (higherWaiting_(dev)) vTaskDelay(1);
+#endif
+  Lock(dev);
+}
+
+bool LokaBus::higherWaiting_(LokaBusDev dev) const {
+  const uint8_t w = _waiting;
+  for (uint8_t d = 0; d < BUS_DEV_COUNT; ++d)
+    if ((w & (1u << d)) && _prio[d] > _prio[dev]) return true;
+  return false;
+}
+
+void LokaBus::ResetStats() {
+  for (uint8_t d = 0; d < BUS_DEV_COUNT; ++d) {
+    _stats[d] = LokaBusStats{0, 0, 0, 0, 0};
+    _lockUs[d] = 0;
+  }
+}
+
+void LokaBus::PrintStats() {
+  static const char* names[BUS_DEV_COUNT] = { "tof", "imu", "light" };
+  for (uint8_t d = 0; d < BUS_DEV_COUNT; ++d) {
+    const LokaBusStats& s = _stats[d];
+    Serial.print(names[d]);
+    Serial.print("\tn=");     Serial.print(s.transfers);
+    Serial.print("\tbusy=");  Serial.print(s.busyUs);
+    Serial.print("us\twait="); Serial.print(s.waitUs);
+    Serial.print("us\tmax="); Serial.print(s.maxWaitUs);
+    Serial.print("us\tyield="); Serial.print(s.yields);
+    Serial.println();
+  }
+}
@@ -0,0 +1,70 @@
+// LokaBus.h
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/semphr.h"
+  #include "freertos/task.h"
+  #define LOKA_BUS_RTOS 1
+#endif
+
+// Devices sharing the Loka I2C bus
+enum LokaBusDev : uint8_t { BUS_TOF, BUS_IMU, BUS_LIGHT, BUS_DEV_COUNT };
+
+struct LokaBusStats {
+  uint32_t transfers;   // Lock/Unlock pairs
+  uint32_t busyUs;      // time holding the bus
+  uint32_t waitUs;      // time waiting for it
+  uint32_t maxWaitUs;
+  uint32_t yields;      // times a long transfer stepped aside
+};
+
+class LokaBus {
+public:
+  LokaBus();
+
+  // Safe to call from every driver: Wire.begin() runs once, the clock only goes up.
+  TwoWire& Begin(uint32_t clockHz = 0, TwoWire& wire = Wire);
+  TwoWire& Port() { return *_wire; }
+
+  // Higher wins. Defaults: IMU 3, light 2, ToF 1.
+  void Priority(LokaBusDev dev, uint8_t prio) { if (dev < BUS_DEV_COUNT) _prio[dev] = prio; }
+
+  void Lock(LokaBusDev dev);
+  void Unlock(LokaBusDev dev);
+  // Between chunks of a long transfer: hand the bus over if a higher priority device waits.
+  void Yield(LokaBusDev dev);
+
+  const LokaBusStats& Stats(LokaBusDev dev) const { return _stats[dev < BUS_DEV_COUNT ? dev : 0]; }
+  void ResetStats();
+  void PrintStats();
+
+private:
+  TwoWire* _wire;
+  bool _begun;
+  uint32_t _clockHz;
+  uint8_t _prio[BUS_DEV_COUNT];
+  LokaBusStats _stats[BUS_DEV_COUNT];
+  uint32_t _lockUs[BUS_DEV_COUNT];
+  volatile uint8_t _waiting;   // bit per device blocked in Lock()
+#if LOKA_BUS_RTOS
+  SemaphoreHandle_t _mutex;
+  portMUX_TYPE _mux;           // guards _waiting across cores
+#endif
+
+  bool higherWaiting_(LokaBusDev dev) const;
+};
+
+// Scope guard: holds the bus for one transaction
+class LokaBusLock {
+public:
+  LokaBusLock(LokaBus& bus, LokaBusDev dev) : _bus(bus), _dev(dev) { _bus.Lock(_dev); }
+  ~LokaBusLock() { _bus.Unlock(_dev); }
+private:
+  LokaBus& _bus;
+  LokaBusDev _dev;
+};
+
+extern LokaBus LokaI2C;
@@ -0,0 +1,353 @@
+// LokaDrive.cpp
+#include "LokaDrive.h"
+
+LokaDrive::LokaDrive(LokaMotor& left, LokaMotor& right)
+: _left(left), _right(right), _track(0.08f), _vmax(0.5f), _invL(false), _invR(false),
+  _v(0.0f), _w(0.0f), _gyro(nullptr), _gyroCookie(nullptr), _kp(0.5f), _ki(2.0f), _ie(0.0f), _lastUs(0), _sat(false), _stopped(true),
+  _head(nullptr), _headCookie(nullptr), _headUs(0), _headSeenUs(0), _headPeriodUs(0), _hw(0.0f), _stale(0), _lost(false),
+  _hold(false), _target(0.0f), _hkp(4.0f), _hki(1.0f), _hkd(0.2f), _wmax(3.0f), _hi(0.0f), _tel(), _mail()
+#if LOKA_DRIVE_TASK
+  , _tmux(portMUX_INITIALIZER_UNLOCKED), _taskStop(false), _taskLive(false), _taskHz(0)
+#endif
+{}
+
+#if defined(ARDUINO_ARCH_ESP32)
+bool LokaDrive::Init(uint32_t freqHz, uint8_t resBits) {
+  const bool l = _left.Init(freqHz, resBits);
+  const bool r = _right.Init(freqHz, resBits);
+  Stop();
+  _lastUs = micros();
+  return l && r;
+}
+#else
+bool LokaDrive::Init() {
+  const bool l = _left.Init();
+  const bool r = _right.Init();
+  Stop();
+  _lastUs = micros();
+  return l && r;
+}
+#endif
+
+void LokaDrive::lock_() const {
+#if LOKA_DRIVE_TASK
+  portENTER_CRITICAL(&_tmux);
+#endif
+}
+
+void LokaDrive::unlock_() const {
+#if LOKA_DRIVE_TASK
+  portEXIT_CRITICAL(&_tmux);
+#endif
+}
+
+void LokaDrive::Drive(float v, float w) {
+  lock_();
+  _mail.move = MOVE_DRIVE;
+  _mail.v = v;
+  _mail.w = w;
+  unlock_();
+  post_();
+}
+
+void LokaDrive::Stop(bool brake) {
+  lock_();
+  _mail.move = MOVE_STOP;
+  _mail.brake = brake;
+  _mail.head = HEAD_RELEASE;
+  unlock_();
+  post_();
+}
+
+void LokaDrive::HeadingGains(float kp, float ki, float kd, float wMax) {
+  _hkp = kp; _hki = ki; _hkd = kd;
+  _wmax = wMax > 0.0f ? wMax : 0.0f;
+}
+
+void LokaDrive::HoldHeading(float yawRad) {
+  lock_();
+  _mail.head = HEAD_HOLD;
+  _mail.yaw = wrapPi_(yawRad);
+  unlock_();
+  post_();
+}
+
+void LokaDrive::TurnBy(float dYawRad) {
+  lock_();
+  if (_mail.head == HEAD_HOLD) {
+    _mail.yaw = wrapPi_(_mail.yaw + dYawRad);
+  } else if (_mail.head == HEAD_TURN) {
+    _mail.yaw += dYawRad;
+  } else {
+    _mail.release = _mail.head == HEAD_RELEASE;
+    _mail.head = HEAD_TURN;
+    _mail.yaw = dYawRad;
+  }
+  unlock_();
+  post_();
+}
+
+void LokaDrive::Release() {
+  lock_();
+  _mail.head = HEAD_RELEASE;
+  unlock_();
+  post_();
+}
+
+// Pending commands count as done, so a Holding() right after HoldHeading() is true
+bool LokaDrive::Holding() const {
+  lock_();
+  const bool h = _mail.head == HEAD_NONE ? _tel.holding : _mail.head != HEAD_RELEASE;
+  unlock_();
+  return h;
+}
+
+bool LokaDrive::Stopped() const {
+  lock_();
+  bool st = _tel.stopped;
+  if (_mail.move != MOVE_NONE) st = _mail.move == MOVE_STOP;
+  if (_mail.head == HEAD_HOLD || _mail.head == HEAD_TURN) st = false;
+  unlock_();
+  return st;
+}
+
+float LokaDrive::LeftPct() const {
+  lock_();
+  const float pct = _tel.left;
+  unlock_();
+  return pct;
+}
+
+float LokaDrive::RightPct() const {
+  lock_();
+  const float pct = _tel.right;
+  unlock_();
+  return pct;
+}
+
+bool LokaDrive::Saturated() const {
+  lock_();
+  const bool sat = _tel.saturated;
+  unlock_();
+  return sat;
+}
+
+// Without a task the caller owns the controller, so the command applies now
+void LokaDrive::post_() {
+#if LOKA_DRIVE_TASK
+  if (_taskLive) return;
+#endif
+  takeMail_();
+}
+
+void LokaDrive::takeMail_() {
+  lock_();
+  const Mail_ m = _mail;
+  _mail.move = MOVE_NONE;
+  _mail.head = HEAD_NONE;
+  unlock_();
+
+  if (m.move == MOVE_DRIVE) { _v = m.v; _w = m.w; _stopped = false; }
+  else if (m.move == MOVE_STOP) stop_(m.brake);
+
+  if (m.head == HEAD_RELEASE) release_();
+  else if (m.head == HEAD_HOLD) hold_(m.yaw);
+  else if (m.head == HEAD_TURN) {
+    if (m.release) release_();
+    turn_(m.yaw);
+  }
+
+  if (m.move != MOVE_NONE || m.head != HEAD_NONE) {
+    lock_();
+    _tel.holding = _hold;
+    _tel.stopped = _stopped;
+    if (_stopped) { _tel.left = _tel.right = 0.0f; _tel.saturated = false; }
+    unlock_();
+  }
+}
+
+void LokaDrive::stop_(bool brake) {
+  _v = _w = 0.0f;
+  _ie = 0.0f;
+  _sat = false;
+  release_();
+  _stopped = true;
+  if (brake) { _left.Brake(); _right.Brake(); }
+  else       { _left.Coast(); _right.Coast(); }
+}
+
+void LokaDrive::hold_(float yawRad) {
+  _target = yawRad;
+  if (!_hold) _hi = 0.0f;
+  _hold = true;
+  _stopped = false;
+}
+
+void LokaDrive::turn_(float dYawRad) {
+  float base = _target;
+  float yaw, rate;
+  uint64_t sampleUs;
+  if (!_hold && _head && _head(_headCookie, yaw, rate, sampleUs)) base = yaw;
+  hold_(wrapPi_(base + dYawRad));
+}
+
+void LokaDrive::release_() {
+  _hold = false;
+  _hi = 0.0f;
+  _headUs = 0;
+  _lost = false;
+}
+
+void LokaDrive::Update() {
+  const uint32_t now = micros();
+  float dt = (now - _lastUs) * 1e-6f;
+  _lastUs = now;
+  if (dt > 0.1f) dt = 0.1f;
+  takeMail_();
+
+  // Stop() already set the bridge: another Ctrl(0) would coast a brake, and feedback on a
+  // standing robot only makes the motors twitch through their deadband
+  if (_stopped) { telemetry_(now, 0.0f, 0.0f, 0.0f, false); return; }
+
+  float w = _w;
+  bool held = false;
+  if (_hold) {
+    float yaw, rate;
+    uint64_t sampleUs;
+    const bool ok = _head && _head(_headCookie, yaw, rate, sampleUs);
+    if (ok && sampleUs != _headUs) {
+      const bool next = _headUs && sampleUs > _headUs && !_lost;
+      if (next) _headPeriodUs = sampleUs - _headUs < 100000 ? (uint32_t)(sampleUs - _headUs) : 100000;
+      const float hdt = next ? _headPeriodUs * 1e-6f : dt;
+      _headUs = sampleUs;
+      _headSeenUs = now;
+      _lost = false;
+      w = _hw = headingPid_(yaw, rate, hdt);
+      held = true;
+    } else {
+      // The IMU reports slower than this loop: stepping again would integrate an old error, so
+      // the last output stands. A source that stopped (hub reset, FastRotOff(), nobody servicing
+      // it) must not keep a turn going, so after a few periods w drops to zero.
+      _stale++;
+      const uint32_t stepUs = (uint32_t)(dt * 1e6f);
+      const uint32_t period = _headPeriodUs > stepUs ? _headPeriodUs : stepUs;
+      _lost = !_headUs || now - _headSeenUs > LOKA_DRIVE_HEADING_TIMEOUT * period;
+      held = !_lost;
+      w = _lost ? 0.0f : _hw;
+    }
+  }
+
+  float gz;
+  if (_gyro && _gyro(_gyroCookie, gz)) {  // no sample: no feedback, and nothing to integrate
+    const float e = w - gz;
+    if (!_sat) _ie += e * dt;          // hold the integral while the wheels are saturated
+    w += _kp * e + _ki * _ie;
+  }
+
+  // wheel speeds as % of full speed
+  const float half = 0.5f * _track * w;
+  float pl = (_v - half) * 100.0f / _vmax;
+  float pr = (_v + half) * 100.0f / _vmax;
+
+  // Scale both together so the ratio, and with it the path curvature, survives saturation
+  const float m = fmaxf(fabsf(pl), fabsf(pr));
+  _sat = m > 100.0f;
+  if (_sat) { const float k = 100.0f / m; pl *= k; pr *= k; }
+
+  _left.Ctrl(_invL ? -pl : pl);
+  _right.Ctrl(_invR ? -pr : pr);
+  _left.Update();
+  _right.Update();
+  telemetry_(now, w, pl, pr, held);
+}
+
+void LokaDrive::telemetry_(uint32_t now, float w, float pl, float pr, bool held) {
+  lock_();
+  _tel.us = now;
+  _tel.wCmd = w;
+  _tel.left = pl; _tel.right = pr;
+  _tel.steps++;
+  if (!held) { _tel.p = _tel.i = _tel.d = 0.0f; }
+  _tel.holding = _hold;
+  _tel.stopped = _stopped;
+  _tel.saturated = _sat;
+  _tel.stale = _stale;
+  _tel.headingLost = _lost;
+  unlock_();
+}
+
+float LokaDrive::headingPid_(float yaw, float rate, float dt) {
+  const float e = wrapPi_(_target - yaw);
+  const float p = _hkp * e;
+  const float d = -_hkd * rate;    // on the measurement: no kick when the target jumps
+  const float u = p + _hi + d;
+  // conditional integration: skip while the output is pinned and the error pushes it further
+  if (!((u >= _wmax && e > 0.0f) || (u <= -_wmax && e < 0.0f))) _hi += _hki * e * dt;
+  _hi = constrain(_hi, -_wmax, _wmax);
+  const float w = constrain(p + _hi + d, -_wmax, _wmax);
+
+  lock_();
+  _tel.target = _target; _tel.heading = yaw; _tel.err = e; _tel.rate = rate;
+  _tel.p = p; _tel.i = _hi; _tel.d = d;
+  unlock_();
+  return w;
+}
+
+float LokaDrive::wrapPi_(float a) {
+  while (a >  PI) a -= TWO_PI;
+  while (a < -PI) a += TWO_PI;
+  return a;
+}
+
+void LokaDrive::Telemetry(LokaDriveTelemetry &t) {
+  lock_();
+  t = _tel;
+  unlock_();
+}
+
+#if LOKA_DRIVE_TASK
+bool LokaDrive::StartTask(uint16_t hz, uint8_t core, uint8_t prio) {
+  if (_taskLive) return true;
+  _taskHz = constrain(hz, (uint16_t)1, (uint16_t)1000);
+  _taskStop = false;
+  _taskLive = true;  // from here commands wait for the task
+  TaskHandle_t handle;
+  if (xTaskCreatePinnedToCore(taskEntry_, "LokaDrive", 4096, this, prio, &handle, core) == pdPASS) return true;
+  _taskLive = false;
+  return false;
+}
+
+// Commands posted after the last step are applied here, the caller owns the drive again
+void LokaDrive::StopTask() {
+  if (!_taskLive) return;
+  _taskStop = true;
+  while (_taskLive) delay(1);
+  takeMail_();
+}
+
+void LokaDrive::taskEntry_(void* arg) {
+  static_cast<LokaDrive*>(arg)->taskLoop_();
+}
+
+void LokaDrive::taskLoop_() {
+  const TickType_t period = pdMS_TO_TICKS(1000 / _taskHz) ? pdMS_TO_TICKS(1000 / _taskHz) : 1;
+  const uint32_t nominalUs = period * portTICK_PERIOD_MS * 1000UL;
+  TickType_t wake = xTaskGetTickCount();
+  uint32_t prevUs = micros();
+  while (!_taskStop) {
+    const bool onTime = xTaskDelayUntil(&wake, period) == pdTRUE;  // pdFALSE: the last step ran long
+    const uint32_t now = micros();
+    const uint32_t per = now - prevUs;
+    prevUs = now;
+    const uint32_t jitter = per > nominalUs ? per - nominalUs : nominalUs - per;
+    lock_();
+    _tel.periodUs = per;
+    if (jitter > _tel.maxJitterUs) _tel.maxJitterUs = jitter;
+    if (!onTime) _tel.overruns++;
+    unlock_();
+    Update();
+  }
+  _taskLive = false;
+  vTaskDelete(nullptr);
+}
+#endif
@@ -0,0 +1,159 @@
+// LokaDrive.h
+#pragma once
+#include <Arduino.h>
+#include "LokaMotors.h"
+
+#ifndef LOKA_DRIVE_HEADING_TIMEOUT
+#define LOKA_DRIVE_HEADING_TIMEOUT 4   // heading sample periods (or steps, if longer) without a new one
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <atomic>
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #define LOKA_DRIVE_TASK 1
+#endif
+
+// Measured yaw rate in rad/s, counter-clockwise positive, false when there is no sample (none yet,
+// or FastRot() never enabled) and the step runs open loop. E.g. LokaMCU::YawRateHook with the
+// LokaMCU as cookie; FastRotLast() can be caught half-written from another task.
+typedef bool (*LokaGyroZFn)(void *cookie, float &rateRad);
+
+// Latest heading in rad, yaw rate in rad/s and the time the sample was taken in us, false when
+// there is no sample yet, e.g. LokaMCU::HeadingHook with the LokaMCU as cookie. Must be safe to
+// call from the drive task. A time that has not moved since the last step marks a stale sample.
+typedef bool (*LokaHeadingFn)(void *cookie, float &yawRad, float &rateRad, uint64_t &sampleUs);
+
+struct LokaDriveTelemetry {
+  uint32_t us;                  // time of the step
+  float    target, heading;     // rad
+  float    err;                 // rad, wrapped to +-pi
+  float    rate;                // rad/s measured
+  float    p, i, d;             // PID terms, rad/s
+  float    wCmd;                // rad/s into the kinematics
+  float    left, right;         // wheel commands, %
+  uint32_t steps;
+  uint32_t periodUs;            // last step-to-step time in the task
+  uint32_t maxJitterUs;         // worst distance from the nominal period
+  uint32_t overruns;            // steps that started late
+  uint32_t stale;               // held steps that found no new heading sample
+  bool     holding, stopped, saturated;
+  bool     headingLost;         // holding, but no new sample for LOKA_DRIVE_HEADING_TIMEOUT periods: w = 0
+};
+
+// Differential drive on two LokaMotor: velocity commands in, both wheels updated together
+class LokaDrive {
+public:
+  LokaDrive(LokaMotor& left, LokaMotor& right);
+
+  // Initialises both motors, with the PWM settings a sketch would give LokaMotor::Init()
+#if defined(ARDUINO_ARCH_ESP32)
+  bool Init(uint32_t freqHz = LOKA_PWM_BASE_FREQ, uint8_t resBits = LOKA_PWM_RES_BITS);
+#else
+  bool Init();
+#endif
+  // Wheel spacing in m and the ground speed one wheel reaches at 100%
+  void Geometry(float trackM, float maxSpeedMps) { _track = trackM; _vmax = maxSpeedMps > 0.0f ? maxSpeedMps : 1.0f; }
+  void Invert(bool left, bool right) { _invL = left; _invR = right; }
+
+  // Commands take effect at the next Update() while the task runs, right away otherwise
+  void Drive(float v, float w);          // m/s forward, rad/s counter-clockwise
+  // Coast or brake both wheels and stay stopped, feedback off, until Drive() or HoldHeading()
+  void Stop(bool brake = false);
+  bool Stopped() const;
+
+  // Yaw-rate feedback: the turn command becomes w + kp * e + ki * integral(e), e = w - measured rate.
+  // The integral is the heading drift, so w = 0 holds a straight line. Keep kp below 1.
+  void GyroHook(LokaGyroZFn fn, void *cookie = nullptr, float kp = 0.5f, float ki = 2.0f) {
+    _gyro = fn; _gyroCookie = cookie; _kp = kp; _ki = ki; _ie = 0.0f;
+  }
+
+  // Heading hold: a PID on the heading error sets w, derivative on the measured rate, output
+  // limited to wMax. The integral stops growing while the output is pinned (anti-windup).
+  // It steps once per new sample, over the time between samples; in between w is kept. When
+  // samples stop coming, or the hook fails, the robot stops turning until they come back.
+  void HeadingHook(LokaHeadingFn fn, void *cookie = nullptr) { _head = fn; _headCookie = cookie; }
+  void HeadingGains(float kp, float ki, float kd, float wMax = 3.0f);
+  void HoldHeading(float yawRad);       // Drive() still sets v, its w is ignored while holding
+  void TurnBy(float dYawRad);           // from the current target, or the measured heading
+  void Release();                       // back to open w commands
+  bool Holding() const;
+
+  // One synchronous step: heading PID, kinematics, feedback, saturation, both motors.
+  // Call at a fixed rate, or let the task do it.
+  void Update();
+#if LOKA_DRIVE_TASK
+  // Runs Update() at hz (whole milliseconds) on a pinned task; the sketch then only commands.
+  // Set geometry, hooks and gains before starting it.
+  bool StartTask(uint16_t hz = 200, uint8_t core = 1, uint8_t prio = 5);
+  void StopTask();
+  bool TaskRunning() const { return _taskLive.load(); }
+#endif
+  void Telemetry(LokaDriveTelemetry &t);
+
+  float LeftPct()  const;
+  float RightPct() const;
+  bool  Saturated() const;  // last step had to scale the wheels down
+
+private:
+  LokaMotor& _left;
+  LokaMotor& _right;
+  float _track, _vmax;
+  bool  _invL, _invR;
+  float _v, _w;
+  LokaGyroZFn _gyro;
+  void *_gyroCookie;
+  float _kp, _ki;
+  float _ie;              // integrated yaw-rate error, rad
+  uint32_t _lastUs;
+  bool  _sat;
+  bool  _stopped;         // Stop() set the bridge, Update() leaves it until the next command
+
+  LokaHeadingFn _head;
+  void *_headCookie;
+  uint64_t _headUs;       // time of the sample the PID last stepped on, 0 for none
+  uint32_t _headSeenUs;   // micros() when it came in
+  uint32_t _headPeriodUs; // between the last two samples, 0 until known
+  float _hw;              // its output
+  uint32_t _stale;
+  bool  _lost;
+  bool  _hold;
+  float _target;
+  float _hkp, _hki, _hkd, _wmax;
+  float _hi;              // heading integral term, rad/s
+  LokaDriveTelemetry _tel;
+
+  // Commands wait here for Update(), the only place that changes the controller and the motors.
+  // The latest of each kind wins; a TurnBy() adds to what is pending.
+  enum : uint8_t { MOVE_NONE, MOVE_DRIVE, MOVE_STOP };
+  enum : uint8_t { HEAD_NONE, HEAD_HOLD, HEAD_TURN, HEAD_RELEASE };
+  struct Mail_ {
+    uint8_t move;
+    float   v, w;
+    bool    brake;
+    uint8_t head;
+    float   yaw;          // HEAD_HOLD: target, HEAD_TURN: step
+    bool    release;      // HEAD_TURN: release first, turn from the measured heading
+  };
+  Mail_ _mail;
+#if LOKA_DRIVE_TASK
+  mutable portMUX_TYPE _tmux;  // guards _tel and _mail between the task and the sketch
+  std::atomic<bool> _taskStop;
+  std::atomic<bool> _taskLive;
+  uint16_t _taskHz;
+  static void taskEntry_(void* arg);
+  void taskLoop_();
+#endif
+
+  void lock_() const;
+  void unlock_() const;
+  void post_();
+  void takeMail_();
+  void stop_(bool brake);
+  void hold_(float yawRad);
+  void turn_(float dYawRad);
+  void release_();
+  float headingPid_(float yaw, float rate, float dt);
+  void telemetry_(uint32_t now, float w, float pl, float pr, bool held);
+  static float wrapPi_(float a);
+};
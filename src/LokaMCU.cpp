@@ -4,6 +4,12 @@
 
 static constexpr uint16_t VCNL_POLL_MS = 50; 
 
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+LokaMCU* LokaMCU::_lightOwner = nullptr;
+
 float     r = 0, p = 0, y = 0;
 float     gx = 0, gy = 0, gz = 0;
 uint16_t  prox = 0, amb = 0;
@@ -21,15 +27,25 @@ void LokaMCU::Init(uint16_t featuresMask) {
   _gyr_en   = featuresMask & GYR;
   _tap_en   = featuresMask & TAP;
 
-  Wire.begin();
+  TwoWire& wire = LokaI2C.Begin();
   delay(5);
 
   if (_rot_en || _gyr_en || _tap_en) {
-    _imu_ok = _imu.begin(Wire);
-    if (_imu_ok) { imuEnable_(); imuTareReset_(); }
+    _imu_ok = _imu.begin(wire);
+    if (_imu_ok) {
+      _imu.wasReset();  // the boot reset; reports are enabled right here
+      imuEnable_();
+      imuTareReset_();
+      if (_warm) {
+        _imu.setCalibrationConfig(SH2_CAL_ACCEL | SH2_CAL_GYRO);
+        _imu.setCalibrationAutoSave(true);
+        tareLoad_();
+      }
+    }
   }
 
-  if (_light_en) vcnlInit_();
+  if (_light_en) _light_ok = _vcnl.begin(wire, VCNL4040_CH_PROX | VCNL4040_CH_AMBIENT |
+                                              (_dark_src == WHITE ? VCNL4040_CH_WHITE : 0));
   if (_rgb_en) _pwr_state = POWER_BAT_RUN;
 
   _last_tick_ms  = millis();
@@ -37,10 +53,16 @@ void LokaMCU::Init(uint16_t featuresMask) {
 }
 
 void LokaMCU::Run(uint8_t hz) {
-  _hz = constrain(hz, (uint8_t)1, (uint8_t)100);
+  hz = constrain(hz, (uint8_t)1, (uint8_t)100);
+  if (hz != _hz) {
+    _hz = hz;
+    if (_imu_ok) imuRates_();  // reports follow the loop rate
+  }
   const uint32_t period_ms = 1000UL / _hz;
 
   while (millis() - _last_tick_ms < period_ms) {
+    if (_imu_ok && (_imu_int ? _imu.dataReady() : _girv_hz != 0)) imuPoll_();
+    if (_light_pin >= 0 && (_light_irq || digitalRead(_light_pin) == LOW)) lightService_();
     delay(1); 
   }
   _last_tick_ms = millis();
@@ -53,13 +75,15 @@ void LokaMCU::Run(uint8_t hz) {
   // poll sensors on the tick
   if (_imu_ok) imuPoll_();
 
+  if (_light_pin >= 0 && (_light_irq || digitalRead(_light_pin) == LOW)) lightService_();
+
   const uint32_t now = millis();
-  if (_light_en && (now - _last_light_ms >= VCNL_POLL_MS)) {
+  if (_light_ok && _light_poll && (now - _last_light_ms >= VCNL_POLL_MS)) {
     _last_light_ms = now;
     vcnlPoll_();
 
-    // auto headlight helper
-    if (_dark_led_en) {
+    // auto headlight helper; with OnDark() the ambient events drive it instead
+    if (_dark_led_en && !(_dark_int && _dark_src == AMB)) {
       const uint16_t sense = (_dark_src == WHITE) ? _white : _amb;
       const bool wantOn = (sense < _dark_led_thr);
       digitalWrite(_dark_led_pin, (_dark_led_activeHigh ? (wantOn ? HIGH : LOW)
@@ -74,6 +98,7 @@ void LokaMCU::SetDarkLED(uint8_t pin, uint16_t threshold, bool activeHigh, LokaD
   _dark_led_en  = (threshold > 0);
   _dark_led_activeHigh = activeHigh;
   _dark_src = src;
+  if (src == WHITE) vcnlChannels_(true);
   pinMode(_dark_led_pin, OUTPUT);
   digitalWrite(_dark_led_pin, _dark_led_activeHigh ? LOW : HIGH); // off by default
 }
@@ -108,17 +133,34 @@ void LokaMCU::TapRead(bool &tapOut) {
   if (tapOut) _tapWasTrue = true;
 }
 
-void LokaMCU::Light(uint16_t &p, uint16_t &a, uint16_t &w) { p=_prox; a=_amb; w=_white; }
+void LokaMCU::Quat(float &w, float &x, float &y, float &z) {
+  quatUpdate_();
+  w = _qw; x = _qx; y = _qy; z = _qz;
+}
+
+void LokaMCU::RotMatrix(float m[9]) {
+  quatUpdate_();
+  const float w = _qw, x = _qx, y = _qy, z = _qz;
+  const float xx = x*x, yy = y*y, zz = z*z;
+  const float xy = x*y, xz = x*z, yz = y*z, wx = w*x, wy = w*y, wz = w*z;
+  m[0] = 1.0f - 2.0f*(yy + zz); m[1] = 2.0f*(xy - wz);        m[2] = 2.0f*(xz + wy);
+  m[3] = 2.0f*(xy + wz);        m[4] = 1.0f - 2.0f*(xx + zz); m[5] = 2.0f*(yz - wx);
+  m[6] = 2.0f*(xz - wy);        m[7] = 2.0f*(yz + wx);        m[8] = 1.0f - 2.0f*(xx + yy);
+}
+
+void LokaMCU::Light(uint16_t &p, uint16_t &a, uint16_t &w) { vcnlChannels_(true); p=_prox; a=_amb; w=_white; }
 void LokaMCU::Light(uint16_t &p, uint16_t &a)              { Light(p); Light(a); }
 
 
 // Rot(): fills r,p,y in that order and prints as r,p,y
 void LokaMCU::Rot() {
+  eulerUpdate_();
   r = _r; _pushUnique(_rotOrder, _rotCount, 'r', 3);
   p = _p; _pushUnique(_rotOrder, _rotCount, 'p', 3);
   y = _y; _pushUnique(_rotOrder, _rotCount, 'y', 3);
 }
 void LokaMCU::Rot(float &a) {
+  eulerUpdate_();
   if (&a == &::r) { a = _r; r = _r; _pushUnique(_rotOrder, _rotCount, 'r', 3); }
   else if (&a == &::p) { a = _p; p = _p; _pushUnique(_rotOrder, _rotCount, 'p', 3); }
   else { a = _y; y = _y; _pushUnique(_rotOrder, _rotCount, 'y', 3); }
@@ -220,14 +262,225 @@ void LokaMCU::TapSens(uint8_t level) {
 
 // ----- IMU internals -----
 void LokaMCU::imuEnable_() {
-  if (_rot_en)  _imu.enableGameRotationVector(10);
-  if (_gyr_en)  _imu.enableGyro(10);
-  if (_tap_en)  { _imu.enableTapDetector(10); _imu.enableAccelerometer(10); _acc_en = true; }
+  for (uint8_t q = 0; q < IMU_Q_COUNT; ++q) _rep_us[q] = 0;  // send every report again
+  imuRates_();
+  if (_tap_en)  { _imu.enableTapDetector(10); _acc_en = true; }
+  if (_girv_hz) _imu.enableReport(SH2_GYRO_INTEGRATED_RV, 1000000UL / _girv_hz);
+}
+
+// Report interval per queue: the override if set, else the Run() rate. The accelerometer feeds
+// the tap detector on every sample, so it does not drop below LOKA_IMU_TAP_HZ.
+uint32_t LokaMCU::reportUs_(LokaImuQ q) const {
+  uint16_t hz = _rate_hz[q] ? _rate_hz[q] : _hz;
+  if (q == IMU_ACC && !_rate_hz[q] && hz < LOKA_IMU_TAP_HZ) hz = LOKA_IMU_TAP_HZ;
+  return 1000000UL / hz;
+}
+
+// Sends only the intervals that changed
+void LokaMCU::imuRates_() {
+  static const sh2_SensorId_t ids[IMU_Q_COUNT] = { SH2_GAME_ROTATION_VECTOR, SH2_GYROSCOPE_CALIBRATED, SH2_ACCELEROMETER };
+  static const uint16_t feats[IMU_Q_COUNT] = { ROT, GYR, TAP };
+  const bool en[IMU_Q_COUNT] = { _rot_en, _gyr_en, _tap_en };
+  for (uint8_t i = 0; i < IMU_Q_COUNT; ++i) {
+    if (!en[i]) continue;
+    const uint32_t us = reportUs_((LokaImuQ)i);
+    if (us == _rep_us[i]) continue;
+    const uint32_t batch = (_batch_mask & feats[i]) ? _batch_us : 0;  // TAP batches the accel, never the tap detector
+    if (_imu.enableReport(ids[i], us, 0, batch)) _rep_us[i] = us;
+  }
+}
+
+void LokaMCU::ImuRate(uint16_t featuresMask, uint16_t hz) {
+  if (hz > 1000) hz = 1000;
+  if (featuresMask & ROT) _rate_hz[IMU_ROT] = hz;
+  if (featuresMask & GYR) _rate_hz[IMU_GYR] = hz;
+  if (featuresMask & TAP) _rate_hz[IMU_ACC] = hz;
+  if (_imu_ok) imuRates_();
+}
+
+void LokaMCU::Tare(bool save) {
+  _q0w = _qrw; _q0x = -_qrx; _q0y = -_qry; _q0z = -_qrz;
+  _have_q0 = true;
+  _quat_dirty = true;
+  if (save) tareStore_();
+}
+
+bool LokaMCU::SaveCalibration() {
+  return _imu_ok && _imu.saveCalibration();
+}
+
+bool LokaMCU::ClearCalibration() {
+#if LOKA_IMU_NVS
+  Preferences prefs;
+  if (prefs.begin("loka", false)) { prefs.remove("tilt"); prefs.end(); }
+#endif
+  _have_q0 = false;
+  _have_tilt = false;
+  for (uint8_t q = 0; q < IMU_Q_COUNT; ++q) _accuracy[q] = 0;
+  return _imu_ok && _imu.clearCalibration();  // the hub resets; imuPoll_ enables the reports again
+}
+
+bool LokaMCU::ImuTrusted(uint8_t minAccuracy) const {
+  if (!_imu_ok) return false;
+  if (_rot_en && _accuracy[IMU_ROT] < minAccuracy) return false;
+  if (_gyr_en && _accuracy[IMU_GYR] < minAccuracy) return false;
+  if (_acc_en && _accuracy[IMU_ACC] < minAccuracy) return false;
+  return true;
+}
+
+// Only the tilt is kept: the game rotation vector's yaw is relative to wherever it booted, so
+// a saved yaw would point somewhere arbitrary after a restart.
+bool LokaMCU::tareLoad_() {
+#if LOKA_IMU_NVS
+  float q[4];
+  Preferences prefs;
+  if (!prefs.begin("loka", true)) return false;
+  const bool ok = prefs.getBytesLength("tilt") == sizeof(q) && prefs.getBytes("tilt", q, sizeof(q)) == sizeof(q);
+  prefs.end();
+  if (!ok) return false;
+  _tiw = q[0]; _tix = q[1]; _tiy = q[2]; _tiz = q[3];
+  _have_tilt = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool LokaMCU::tareStore_() {
+  // reference = conj(q0) = Rz(yaw) * tilt, keep tilt = Rz(-yaw) * reference
+  const float rw = _q0w, rx = -_q0x, ry = -_q0y, rz = -_q0z;
+  const float half = 0.5f * atan2f(2.0f * (rw * rz + rx * ry), 1.0f - 2.0f * (ry * ry + rz * rz));
+  quatMul_(cosf(half), 0.0f, 0.0f, -sinf(half), rw, rx, ry, rz, _tiw, _tix, _tiy, _tiz);
+  _have_tilt = true;
+#if LOKA_IMU_NVS
+  const float q[4] = { _tiw, _tix, _tiy, _tiz };
+  Preferences prefs;
+  if (!prefs.begin("loka", false)) return false;
+  const bool ok = prefs.putBytes("tilt", q, sizeof(q)) == sizeof(q);
+  prefs.end();
+  return ok;
+#else
+  return false;
+#endif
+}
+
+// First sample after boot or a hub reset: zero yaw here, roll and pitch against the saved tilt
+void LokaMCU::tareFirst_() {
+  if (_have_tilt) {
+    const float half = 0.5f * atan2f(2.0f * (_qrw * _qrz + _qrx * _qry), 1.0f - 2.0f * (_qry * _qry + _qrz * _qrz));
+    float rw, rx, ry, rz;
+    quatMul_(cosf(half), 0.0f, 0.0f, sinf(half), _tiw, _tix, _tiy, _tiz, rw, rx, ry, rz);
+    _q0w = rw; _q0x = -rx; _q0y = -ry; _q0z = -rz;
+  } else {
+    _q0w = _qrw; _q0x = -_qrx; _q0y = -_qry; _q0z = -_qrz;
+  }
+  _have_q0 = true;
+}
+
+void LokaMCU::FastRot(uint16_t hz, LokaFastRotCb cb) {
+  _girv_hz = constrain(hz, (uint16_t)1, (uint16_t)1000);
+  _girv_cb = cb;
+  if (_imu_ok) _imu.enableReport(SH2_GYRO_INTEGRATED_RV, 1000000UL / _girv_hz);
+}
+
+bool LokaMCU::Heading(float &yawRad, float &rateRad, uint64_t *sampleUs) const {
+  LokaFastRot s;
+  uint32_t a, b;
+  do {  // retry if the sample changed while it was copied
+    a = __atomic_load_n(&_fast_seq, __ATOMIC_ACQUIRE);
+    s = _fast;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    b = __atomic_load_n(&_fast_seq, __ATOMIC_RELAXED);
+  } while ((a & 1) || a != b);
+  if (!s.us) return false;
+  yawRad  = atan2f(2.0f * (s.w * s.z + s.x * s.y), 1.0f - 2.0f * (s.y * s.y + s.z * s.z));
+  rateRad = s.wz;
+  if (sampleUs) *sampleUs = s.us;
+  return true;
+}
+
+bool LokaMCU::HeadingHook(void *mcu, float &yawRad, float &rateRad, uint64_t &sampleUs) {
+  return static_cast<const LokaMCU*>(mcu)->Heading(yawRad, rateRad, &sampleUs);
+}
+
+bool LokaMCU::YawRateHook(void *mcu, float &rateRad) {
+  float yaw;
+  return static_cast<const LokaMCU*>(mcu)->Heading(yaw, rateRad);
+}
+
+void LokaMCU::FastRotOff() {
+  if (_imu_ok && _girv_hz) _imu.enableReport(SH2_GYRO_INTEGRATED_RV, 0);
+  _girv_hz = 0;
+  _girv_cb = nullptr;
+}
+
+void LokaMCU::ImuInt(uint8_t pin) {
+  _imu_int = _imu.useInterrupt(pin);
+}
+
+void LokaMCU::ImuPolling() {
+  _imu.usePolling();
+  _imu_int = false;
+}
+
+void LokaMCU::Batch(uint16_t ms, uint16_t featuresMask) {
+  _batch_us   = (uint32_t)ms * 1000UL;
+  _batch_mask = featuresMask;
+  if (_imu_ok) imuEnable_();
+}
+
+uint16_t LokaMCU::ImuAvailable(LokaImuQ q) const {
+  return (q < IMU_Q_COUNT) ? (uint16_t)(_q[q].head - _q[q].tail) : 0;
+}
+
+uint16_t LokaMCU::ImuAvailable() const {
+  uint16_t n = 0;
+  for (uint8_t q = 0; q < IMU_Q_COUNT; ++q) n += ImuAvailable((LokaImuQ)q);
+  return n;
+}
+
+bool LokaMCU::ImuRead(LokaImuQ q, LokaImuSample &s) {
+  if (!ImuAvailable(q)) return false;
+  ImuQueue_ &iq = _q[q];
+  s = iq.s[iq.tail & (LOKA_IMU_QUEUE - 1)];
+  iq.tail++;
+  return true;
+}
+
+bool LokaMCU::ImuRead(LokaImuSample &s) {
+  int8_t best = -1;
+  for (uint8_t q = 0; q < IMU_Q_COUNT; ++q) {
+    if (!ImuAvailable((LokaImuQ)q)) continue;
+    if (best < 0 || _q[q].s[_q[q].tail & (LOKA_IMU_QUEUE - 1)].us <
+                    _q[best].s[_q[best].tail & (LOKA_IMU_QUEUE - 1)].us) best = q;
+  }
+  return best >= 0 && ImuRead((LokaImuQ)best, s);
+}
+
+bool LokaMCU::ImuLatest(LokaImuQ q, LokaImuSample &s) {
+  if (!ImuAvailable(q)) return false;
+  ImuQueue_ &iq = _q[q];
+  s = iq.s[(uint16_t)(iq.head - 1) & (LOKA_IMU_QUEUE - 1)];
+  iq.tail = iq.head;
+  return true;
+}
+
+const LokaImuStats& LokaMCU::ImuStats() {
+  _imu_stats.backlog = ImuAvailable();
+  _imu_stats.hubOverruns = _imu.getEventOverruns() - _hub_ovr0;
+  return _imu_stats;
+}
+
+void LokaMCU::ImuClearStats() {
+  _imu_stats = LokaImuStats{0, 0, 0, 0, 0, 0, 0};
+  _hub_ovr0 = _imu.getEventOverruns();
 }
 
 void LokaMCU::imuTareReset_() {
   _have_q0 = false;
   _r = _p = _y = 0;
+  _qw = 1.0f; _qx = _qy = _qz = 0.0f;
+  _quat_dirty = _euler_dirty = false;
   _gx = _gy = _gz = 0;
   _tap_flag = false;
   _amagEMA = 9.8f;
@@ -235,78 +488,211 @@ void LokaMCU::imuTareReset_() {
 }
 
 void LokaMCU::imuPoll_() {
-  for (int i=0;i<6;++i) {
-    if (!_imu.getSensorEvent()) break;
-    switch (_imu.getSensorEventID()) {
-      case SH2_GAME_ROTATION_VECTOR: {
-        float w=_imu.getGameReal(), x=_imu.getGameI(), y=_imu.getGameJ(), z=_imu.getGameK();
-        if (!_have_q0) { _q0w=w; _q0x=-x; _q0y=-y; _q0z=-z; _have_q0=true; }
-        float rw,rx,ry,rz; quatMul_(w,x,y,z, _q0w,_q0x,_q0y,_q0z, rw,rx,ry,rz);
-        quatToEulerDeg_(rw,rx,ry,rz, _r,_p,_y);
-        break;
-      }
-      case SH2_GYROSCOPE_CALIBRATED:
-        _gx = _imu.getGyroX() * RAD_TO_DEG;
-        _gy = _imu.getGyroY() * RAD_TO_DEG;
-        _gz = _imu.getGyroZ() * RAD_TO_DEG;
-        break;
-      case SH2_ACCELEROMETER: {
-        if (_acc_en) {
-          _ax = _imu.getAccelX();
-          _ay = _imu.getAccelY();
-          _az = _imu.getAccelZ();
-          float mag = sqrtf(_ax*_ax + _ay*_ay + _az*_az);
-          _amagEMA = (1.0f - _tap_alpha) * _amagEMA + _tap_alpha * mag;
-          float spike = mag - _amagEMA;
-          const uint32_t now = millis();
-          if (spike > _tap_thresh && (now - _last_tap_ms) > _tap_refract_ms) {
-            _tap_flag = true;
-            _last_tap_ms = now;
-          }
+  if (_imu.wasReset()) {  // a hub reset drops every report configuration and restarts the numbering
+    _seq_seen = 0;
+    imuEnable_();
+  }
+  if (_imu_int && !_imu.dataReady()) return;
+  // one packet can carry a whole batch; keep servicing until the hub is empty or the budget is spent
+  const uint32_t t0 = micros();
+  sh2_SensorValue_t v;
+  for (uint8_t i = 0; i < LOKA_IMU_DRAIN_MAX; ++i) {
+    _imu.serviceBus();
+    uint8_t n = 0;
+    while (_imu.popSensorEvent(v)) { imuEvent_(v); ++n; }
+    if (!n) return;
+    _imu_stats.packets++;
+    if (_poll_budget_us && (micros() - t0) >= _poll_budget_us) {
+      _imu_stats.budgetHits++;
+      return;
+    }
+  }
+}
+
+void LokaMCU::imuPush_(LokaImuQ q, uint8_t id, uint64_t us, float a, float b, float c, float d) {
+  ImuQueue_ &iq = _q[q];
+  if ((uint16_t)(iq.head - iq.tail) >= LOKA_IMU_QUEUE) {  // full: drop the oldest
+    iq.tail++;
+    _imu_stats.overruns++;
+  }
+  LokaImuSample &s = iq.s[iq.head & (LOKA_IMU_QUEUE - 1)];
+  s.us = us; s.id = id;
+  s.v[0] = a; s.v[1] = b; s.v[2] = c; s.v[3] = d;
+  iq.head++;
+  const uint16_t depth = (uint16_t)(iq.head - iq.tail);
+  if (depth > _imu_stats.maxBacklog) _imu_stats.maxBacklog = depth;
+}
+
+void LokaMCU::imuSeq_(LokaImuQ q, uint8_t seq) {
+  if (_seq_seen & (1u << q)) _imu_stats.seqGaps += (uint8_t)(seq - _seq[q] - 1);
+  _seq[q] = seq;
+  _seq_seen |= (1u << q);
+}
+
+// Fast path for the gyro-integrated RV: tare, publish, call back. Not queued, at 1 kHz it
+// would overrun every queue; the callback is the consumer.
+void LokaMCU::imuFastRot_(const sh2_SensorValue_t &v) {
+  const sh2_GyroIntegratedRV_t &g = v.un.gyroIntegratedRV;
+  _qrw = g.real; _qrx = g.i; _qry = g.j; _qrz = g.k;
+  if (!_have_q0) tareFirst_();
+  quatMul_(_qrw,_qrx,_qry,_qrz, _q0w,_q0x,_q0y,_q0z, _qw,_qx,_qy,_qz);
+  _quat_dirty = false;
+  _euler_dirty = true;
+  if (_rot_us) _rot_dt_us = (uint32_t)(v.timestamp - _rot_us);
+  _rot_us = v.timestamp;
+
+  __atomic_fetch_add(&_fast_seq, 1, __ATOMIC_ACQ_REL);
+  _fast.us = v.timestamp;
+  _fast.w = _qw; _fast.x = _qx; _fast.y = _qy; _fast.z = _qz;
+  _fast.wx = g.angVelX; _fast.wy = g.angVelY; _fast.wz = g.angVelZ;
+  __atomic_fetch_add(&_fast_seq, 1, __ATOMIC_RELEASE);
+  if (_girv_cb) _girv_cb(_fast);
+}
+
+void LokaMCU::imuEvent_(const sh2_SensorValue_t &v) {
+  if (v.sensorId == SH2_GYRO_INTEGRATED_RV) { imuFastRot_(v); return; }
+  const uint64_t t_us = v.timestamp;
+  switch (v.sensorId) {
+    case SH2_GAME_ROTATION_VECTOR: {
+      imuSeq_(IMU_ROT, v.sequence);
+      _accuracy[IMU_ROT] = v.status & 0x03;
+      const sh2_RotationVector_t &q = v.un.gameRotationVector;
+      imuPush_(IMU_ROT, v.sensorId, t_us, q.i, q.j, q.k, q.real);
+      if (_girv_hz) break;  // the gyro-integrated RV owns orientation
+      if (_rot_us) _rot_dt_us = (uint32_t)(t_us - _rot_us);
+      _rot_us = t_us;
+      _qrw = q.real; _qrx = q.i; _qry = q.j; _qrz = q.k;
+      if (!_have_q0) tareFirst_();
+      _quat_dirty = true;  // tare and Euler wait until someone asks
+      break;
+    }
+    case SH2_GYROSCOPE_CALIBRATED:
+      imuSeq_(IMU_GYR, v.sequence);
+      _accuracy[IMU_GYR] = v.status & 0x03;
+      if (_gyr_us) _gyr_dt_us = (uint32_t)(t_us - _gyr_us);
+      _gyr_us = t_us;
+      imuPush_(IMU_GYR, v.sensorId, t_us, v.un.gyroscope.x, v.un.gyroscope.y, v.un.gyroscope.z);
+      _gx = v.un.gyroscope.x * RAD_TO_DEG;
+      _gy = v.un.gyroscope.y * RAD_TO_DEG;
+      _gz = v.un.gyroscope.z * RAD_TO_DEG;
+      break;
+    case SH2_ACCELEROMETER: {
+      if (_acc_en) {
+        imuSeq_(IMU_ACC, v.sequence);
+        _accuracy[IMU_ACC] = v.status & 0x03;
+        _acc_us = t_us;
+        _ax = v.un.accelerometer.x;
+        _ay = v.un.accelerometer.y;
+        _az = v.un.accelerometer.z;
+        imuPush_(IMU_ACC, v.sensorId, t_us, _ax, _ay, _az);
+        float mag = sqrtf(_ax*_ax + _ay*_ay + _az*_az);
+        _amagEMA = (1.0f - _tap_alpha) * _amagEMA + _tap_alpha * mag;
+        float spike = mag - _amagEMA;
+        const uint32_t now = (uint32_t)(t_us / 1000);  // sample time: batched samples arrive late
+        if (spike > _tap_thresh && (now - _last_tap_ms) > _tap_refract_ms) {
+          _tap_flag = true;
+          _last_tap_ms = now;
         }
-        break;
       }
-      case SH2_TAP_DETECTOR:
-        _tap_flag = true;
-        break;
-      default: break;
+      break;
     }
+    case SH2_TAP_DETECTOR:
+      _tap_flag = true;
+      break;
+    default: break;
   }
 }
 
 // ----- VCNL4040 internals -----
-bool LokaMCU::vcnlInit_() {
-  Wire.beginTransmission(VCNL4040_I2C_ADDR);
-  if (Wire.endTransmission() != 0) return false;
-  if (!vcnlWriteU16_(VCNL4040_ALS_CONF,    0x0000)) return false;
-  if (!vcnlWriteU16_(VCNL4040_PS_CONF1_2,  0x080E)) return false;
-  if (!vcnlWriteU16_(VCNL4040_PS_CONF3_MS, 0x4710)) return false;
-  return true;
+// White is only read once something asks for it
+void LokaMCU::vcnlChannels_(bool white) {
+  if (!_light_ok) return;
+  const uint8_t ch = VCNL4040_CH_PROX | VCNL4040_CH_AMBIENT | (white ? VCNL4040_CH_WHITE : 0);
+  if (ch != _vcnl.getChannels()) _vcnl.setChannels(ch);
 }
 
-bool LokaMCU::vcnlReadU16_(uint8_t reg, uint16_t &out) {
-  Wire.beginTransmission(VCNL4040_I2C_ADDR);
-  Wire.write(reg);
-  if (Wire.endTransmission(false) != 0) return false;
-  if (Wire.requestFrom((int)VCNL4040_I2C_ADDR, 2) != 2) return false;
-  uint8_t l = Wire.read(), h = Wire.read();
-  out = (uint16_t)l | ((uint16_t)h << 8);
-  return true;
+void LokaMCU::LightInt(uint8_t pin, bool keepPolling) {
+  if (_light_pin >= 0) detachInterrupt(digitalPinToInterrupt(_light_pin));
+  _light_pin  = pin;
+  _light_poll = keepPolling;
+  _light_irq  = false;
+  _lightOwner = this;
+  pinMode(pin, INPUT_PULLUP);  // open drain, held low until INT_FLAG is read
+  attachInterrupt(digitalPinToInterrupt(pin), onLightInt_, FALLING);
+}
+
+void LokaMCU::OnNear(uint16_t nearAbove, uint16_t farBelow, LokaLightCb cb) {
+  _near_hi = nearAbove;
+  _near_cb = cb;
+  if (!_light_ok) return;
+  _vcnl.setProxThresholds(farBelow, nearAbove);
+  _vcnl.setProxInterrupt(VCNL4040_PS_INT_BOTH);
+}
+
+void LokaMCU::OnDark(uint16_t darkBelow, uint16_t brightAbove, LokaLightCb cb) {
+  _dark_lo  = darkBelow;
+  _dark_hi  = brightAbove;
+  _dark_cb  = cb;
+  _dark_int = _light_ok;
+  if (!_light_ok) return;
+  darkWindow_();
+  _vcnl.setAmbientInterrupt(true);
+}
+
+// The ALS interrupt fires whenever the reading is outside the window, so the window follows the
+// state: while bright only falling below darkBelow counts, while dark only rising above brightAbove.
+void LokaMCU::darkWindow_() {
+  if (_dark) _vcnl.setAmbientThresholds(0, _dark_hi);
+  else       _vcnl.setAmbientThresholds(_dark_lo, 0xFFFF);
+}
+
+void IRAM_ATTR LokaMCU::onLightInt_() {
+  if (_lightOwner) _lightOwner->_light_irq = true;
 }
 
-bool LokaMCU::vcnlWriteU16_(uint8_t reg, uint16_t val) {
-  Wire.beginTransmission(VCNL4040_I2C_ADDR);
-  Wire.write(reg);
-  Wire.write(val & 0xFF);
-  Wire.write((val >> 8) & 0xFF);
-  return Wire.endTransmission() == 0;
+void LokaMCU::lightService_() {
+  _light_irq = false;
+  uint8_t f;
+  if (!_vcnl.readInterruptFlags(f) || !f) return;  // reading the flags releases INT
+  vcnlPoll_();
+
+  if (f & (VCNL4040_INT_PS_CLOSE | VCNL4040_INT_PS_AWAY)) {
+    bool near = (f & VCNL4040_INT_PS_CLOSE) != 0;
+    if ((f & VCNL4040_INT_PS_CLOSE) && (f & VCNL4040_INT_PS_AWAY)) near = _prox >= _near_hi;
+    if (near != _near) { _near = near; if (_near_cb) _near_cb(_near); }
+  }
+
+  if (f & (VCNL4040_INT_ALS_LOW | VCNL4040_INT_ALS_HIGH)) {
+    bool dark = (f & VCNL4040_INT_ALS_LOW) != 0;
+    if ((f & VCNL4040_INT_ALS_LOW) && (f & VCNL4040_INT_ALS_HIGH)) dark = _amb < _dark_lo;
+    if (dark != _dark) {
+      _dark = dark;
+      darkWindow_();
+      if (_dark_led_en && _dark_src == AMB) Headlight(_dark);
+      if (_dark_cb) _dark_cb(_dark);
+    }
+  }
 }
 
 void LokaMCU::vcnlPoll_() {
-  uint16_t v;
-  if (vcnlReadU16_(VCNL4040_PROX,    v)) _prox  = v;
-  if (vcnlReadU16_(VCNL4040_AMBIENT, v)) _amb   = v;
-  if (vcnlReadU16_(VCNL4040_WHITE,   v)) _white = v;
+  if (!_vcnl.read()) return;
+  _prox  = _vcnl.getProximity();
+  _amb   = _vcnl.getAmbient();
+  _white = _vcnl.getWhite();
+}
+
+void LokaMCU::quatUpdate_() {
+  if (!_quat_dirty) return;
+  quatMul_(_qrw,_qrx,_qry,_qrz, _q0w,_q0x,_q0y,_q0z, _qw,_qx,_qy,_qz);
+  _quat_dirty = false;
+  _euler_dirty = true;
+}
+
+void LokaMCU::eulerUpdate_() {
+  quatUpdate_();
+  if (!_euler_dirty) return;
+  quatToEulerDeg_(_qw,_qx,_qy,_qz, _r,_p,_y, _fast_euler);
+  _euler_dirty = false;
 }
 
 void LokaMCU::quatMul_(float aw,float ax,float ay,float az,
@@ -319,16 +705,37 @@ void LokaMCU::quatMul_(float aw,float ax,float ay,float az,
 }
 
 void LokaMCU::quatToEulerDeg_(float w, float x, float y, float z,
-                              float &roll, float &pitch, float &yaw) {
+                              float &roll, float &pitch, float &yaw, bool fast) {
   float sinr_cosp = 2.0f * (w * x + y * z);
   float cosr_cosp = 1.0f - 2.0f * (x * x + y * y);
-  roll = atan2f(sinr_cosp, cosr_cosp) * 180.0f / PI;
+  roll = (fast ? fastAtan2f_(sinr_cosp, cosr_cosp) : atan2f(sinr_cosp, cosr_cosp)) * 180.0f / PI;
 
   float sinp = 2.0f * (w * y - z * x);
   if (fabsf(sinp) >= 1.0f) pitch = copysignf(90.0f, sinp);
-  else pitch = asinf(sinp) * 180.0f / PI;
+  else pitch = (fast ? fastAsinf_(sinp) : asinf(sinp)) * 180.0f / PI;
 
   float siny_cosp = 2.0f * (w * z + x * y);
   float cosy_cosp = 1.0f - 2.0f * (y * y + z * z);
-  yaw = atan2f(siny_cosp, cosy_cosp) * 180.0f / PI;
+  yaw = (fast ? fastAtan2f_(siny_cosp, cosy_cosp) : atan2f(siny_cosp, cosy_cosp)) * 180.0f / PI;
+}
+
+// atan on [0,1], Abramowitz & Stegun 4.4.49; |error| < 1.2e-5 rad over the full circle
+float LokaMCU::fastAtan2f_(float y, float x) {
+  const float ax = fabsf(x), ay = fabsf(y);
+  if (ax == 0.0f && ay == 0.0f) return 0.0f;
+  const bool swap = ay > ax;
+  const float z  = swap ? ax / ay : ay / ax;
+  const float z2 = z * z;
+  float a = z * (0.9998660f + z2 * (-0.3302995f + z2 * (0.1801410f + z2 * (-0.0851330f + z2 * 0.0208351f))));
+  if (swap)     a = HALF_PI - a;
+  if (x < 0.0f) a = PI - a;
+  return (y < 0.0f) ? -a : a;
+}
+
+// Abramowitz & Stegun 4.4.45; |error| < 6.8e-5 rad on [-1,1]
+float LokaMCU::fastAsinf_(float x) {
+  const float ax = fabsf(x);
+  if (ax >= 1.0f) return copysignf(HALF_PI, x);
+  const float a = HALF_PI - sqrtf(1.0f - ax) * (1.5707288f + ax * (-0.2121144f + ax * (0.0742610f - ax * 0.0187293f)));
+  return copysignf(a, x);
 }
@@ -2,6 +2,13 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include "mcu/BNO085.h"
+#include "mcu/VCNL4040.h"
+#include "LokaBus.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <Preferences.h>
+  #define LOKA_IMU_NVS 1   // reference orientation survives power-off
+#endif
 
 #define LIGHT  0x0001
 #define RGB    0x0002
@@ -18,16 +25,43 @@ enum PowerState : uint8_t {
   POWER_BAT_CHRG= 5
 };
 
-#define VCNL4040_I2C_ADDR    0x60
-#define VCNL4040_ALS_CONF    0x00
-#define VCNL4040_PS_CONF1_2  0x03
-#define VCNL4040_PS_CONF3_MS 0x04
-#define VCNL4040_PROX        0x08
-#define VCNL4040_AMBIENT     0x09
-#define VCNL4040_WHITE       0x0A
-
 enum LokaDarkSource : uint8_t { AMB=0, WHITE=1 };
 
+typedef void (*LokaLightCb)(bool state);   // true = near / dark
+
+// One IMU report as delivered by the hub, kept with its sample time
+struct LokaImuSample {
+  uint64_t us;       // BNO085 timebase, see NowUs()
+  uint8_t  id;       // SH2_GAME_ROTATION_VECTOR, SH2_GYROSCOPE_CALIBRATED or SH2_ACCELEROMETER
+  float    v[4];     // rot: i,j,k,real   gyro: rad/s x,y,z   accel: m/s^2 x,y,z
+};
+
+// Gyro-integrated rotation vector report, tared
+struct LokaFastRot {
+  uint64_t us;
+  float    w, x, y, z;     // unit quaternion
+  float    wx, wy, wz;     // angular velocity, rad/s
+};
+typedef void (*LokaFastRotCb)(const LokaFastRot &s);
+
+#ifndef LOKA_IMU_QUEUE
+#define LOKA_IMU_QUEUE 32   // samples held per sensor between reads, power of two
+#endif
+#define LOKA_IMU_DRAIN_MAX 32  // packets per service pass
+#define LOKA_IMU_TAP_HZ    100 // accel floor while it follows Run(), tap spikes need it
+
+enum LokaImuQ : uint8_t { IMU_ROT, IMU_GYR, IMU_ACC, IMU_Q_COUNT };
+
+struct LokaImuStats {
+  uint16_t backlog;      // samples waiting in the queues now
+  uint16_t maxBacklog;   // deepest a single queue has been
+  uint32_t overruns;     // samples pushed out of a full queue
+  uint32_t seqGaps;      // reports the hub numbered but never delivered
+  uint32_t hubOverruns;  // reports lost in the BNO085 event queue
+  uint32_t budgetHits;   // polls stopped by the budget with data still coming
+  uint32_t packets;      // service passes that delivered reports
+};
+
 class LokaMCU {
 public:
   LokaMCU() {}
@@ -66,9 +100,82 @@ public:
   void PrintIMU(bool withLabels = true);
   void PrintLight(bool withLabels = true);
 
+  // Tared orientation without trigonometry: unit quaternion (w,x,y,z) and the matching
+  // row-major rotation matrix (body to world)
+  void Quat(float &w, float &x, float &y, float &z);
+  void RotMatrix(float m[9]);
+  // Polynomial atan2/asin for Rot(): error < 0.001 deg roll/yaw, < 0.004 deg pitch
+  void FastEuler(bool on) { _fast_euler = on; _euler_dirty = true; }
+
+  // Light events from the VCNL4040 INT line instead of polling. Thresholds and hysteresis live
+  // in the sensor; callbacks run from Run() when the state flips. Polling stops unless asked.
+  void LightInt(uint8_t pin, bool keepPolling = false);
+  void OnNear(uint16_t nearAbove, uint16_t farBelow, LokaLightCb cb = nullptr);
+  void OnDark(uint16_t darkBelow, uint16_t brightAbove, LokaLightCb cb = nullptr);
+  bool Near() const { return _near; }
+  bool Dark() const { return _dark; }
+
+  // Integration time, duty cycle and LED current of the light sensor
+  VCNL4040& LightSensor() { return _vcnl; }
+
   uint16_t LightProximity() const { return _prox; }
   uint16_t LightAmbient()  const { return _amb;  }
 
+  // IMU sample times in us (BNO085 timebase, 64-bit micros())
+  uint64_t RotTimeUs()   const { return _rot_us; }
+  uint64_t GyroTimeUs()  const { return _gyr_us; }
+  uint64_t AccelTimeUs() const { return _acc_us; }
+  uint32_t RotDtUs()     const { return _rot_dt_us; }  // interval between the last two samples
+  uint32_t GyroDtUs()    const { return _gyr_dt_us; }
+  uint64_t NowUs()             { return _imu.getTimeUs(); }
+
+  // Report rates follow Run(hz) (the accel keeps at least LOKA_IMU_TAP_HZ). hz pins the masked
+  // features (ROT, GYR, TAP) to a fixed rate instead, 0 follows Run() again.
+  void     ImuRate(uint16_t featuresMask, uint16_t hz);
+
+  // Warm start (call before Init): the hub keeps and restores its own calibration, and the
+  // saved reference tilt (roll, pitch) applies from the first sample. Yaw is zeroed on the
+  // first sample as usual: the game rotation vector starts a new heading at every boot.
+  void     WarmStart(bool on = true) { _warm = on; }
+  void     Tare(bool save = false);       // current pose becomes zero; save keeps its tilt across boots
+  bool     SaveCalibration();             // write the hub's calibration now instead of waiting
+  bool     ClearCalibration();            // forget calibration and the saved tare
+  // Accuracy reported by the hub: 0 unreliable, 1 low, 2 medium, 3 high
+  uint8_t  ImuAccuracy(LokaImuQ q) const { return q < IMU_Q_COUNT ? _accuracy[q] : 0; }
+  bool     ImuTrusted(uint8_t minAccuracy = 2) const;
+
+  // High-rate orientation: gyro-integrated RV at hz (up to ~1000), cb runs once per report.
+  // Run() keeps servicing the IMU while it waits; ImuService() does the same from any loop.
+  void     FastRot(uint16_t hz, LokaFastRotCb cb = nullptr);
+  void     FastRotOff();
+  const LokaFastRot& FastRotLast() const { return _fast; }
+  // Tared yaw (rad, counter-clockwise), yaw rate and hub timestamp (us) of the latest FastRot
+  // sample. Consistent when called from another task while Run() updates it.
+  bool     Heading(float &yawRad, float &rateRad, uint64_t *sampleUs = nullptr) const;
+  // LokaDrive hooks, cookie = the LokaMCU: drive.HeadingHook(LokaMCU::HeadingHook, &mcu)
+  static bool  HeadingHook(void *mcu, float &yawRad, float &rateRad, uint64_t &sampleUs);
+  static bool  YawRateHook(void *mcu, float &rateRad);
+  void     ImuService() { if (_imu_ok) imuPoll_(); }
+
+  // BNO085 H_INTN on pin: no bus reads while the hub is idle, reports taken as they arrive
+  void     ImuInt(uint8_t pin);
+  void     ImuPolling();
+
+  // Hub FIFO batching: reports of the masked features (ROT, GYR, TAP) are held up to ms
+  // and arrive together. 0 = deliver each report as it is made.
+  void     Batch(uint16_t ms, uint16_t featuresMask = ROT | GYR | TAP);
+  // Time spent draining the hub per Run() tick, 0 = until empty
+  void     PollBudget(uint32_t us) { _poll_budget_us = us; }
+  // Every sample since the last read, oldest first, or just the newest one
+  uint16_t ImuAvailable(LokaImuQ q) const;
+  uint16_t ImuAvailable() const;
+  bool     ImuRead(LokaImuQ q, LokaImuSample &s);
+  bool     ImuRead(LokaImuSample &s);            // oldest across all queues
+  bool     ImuLatest(LokaImuQ q, LokaImuSample &s); // newest, discards the rest
+  const LokaImuStats& ImuStats();
+  uint32_t ImuDropped() { const LokaImuStats& st = ImuStats(); return st.seqGaps + st.overruns + st.hubOverruns; }
+  void     ImuClearStats();
+
 private:
   // IMU
   BNO085   _imu;
@@ -76,6 +183,15 @@ private:
   bool     _rot_en = false, _gyr_en = false, _tap_en = false;
 
   float    _r = 0, _p = 0, _y = 0;
+  float    _qrw = 1.0f, _qrx = 0.0f, _qry = 0.0f, _qrz = 0.0f;   // last raw game RV
+  float    _qw = 1.0f, _qx = 0.0f, _qy = 0.0f, _qz = 0.0f;       // tared
+  bool     _quat_dirty = false, _euler_dirty = false;
+  bool     _fast_euler = false;
+
+  uint16_t _girv_hz = 0;
+  LokaFastRotCb _girv_cb = nullptr;
+  LokaFastRot _fast = {0, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  uint32_t _fast_seq = 0;           // odd while _fast is being written
   float    _gx = 0, _gy = 0, _gz = 0;
   volatile bool _tap_flag = false;
 
@@ -87,11 +203,33 @@ private:
   uint32_t _tap_refract_ms = 120;
   uint32_t _last_tap_ms = 0;
 
+  uint64_t _rot_us = 0, _gyr_us = 0, _acc_us = 0;
+  uint32_t _rot_dt_us = 0, _gyr_dt_us = 0;
+
+  uint32_t _batch_us = 0;
+  uint16_t _rate_hz[IMU_Q_COUNT] = {0, 0, 0};   // overrides, 0 = Run() rate
+  uint32_t _rep_us[IMU_Q_COUNT]  = {0, 0, 0};   // intervals last sent to the hub
+  uint16_t _batch_mask = 0;
+  struct ImuQueue_ { LokaImuSample s[LOKA_IMU_QUEUE]; uint16_t head = 0, tail = 0; };
+  ImuQueue_ _q[IMU_Q_COUNT];
+  LokaImuStats _imu_stats = {0, 0, 0, 0, 0, 0, 0};
+  uint32_t _poll_budget_us = 2000;
+  bool     _imu_int = false;
+  uint32_t _hub_ovr0 = 0;           // BNO085 overrun count at the last ImuClearStats()
+  uint8_t  _seq[IMU_Q_COUNT] = {0, 0, 0};  // last sequence number per queue
+  uint8_t  _seq_seen = 0;
+
   bool     _have_q0 = false;
+  bool     _have_tilt = false;
+  bool     _warm = false;
+  uint8_t  _accuracy[IMU_Q_COUNT] = {0, 0, 0};
   float    _q0w = 1.0f, _q0x = 0.0f, _q0y = 0.0f, _q0z = 0.0f;
+  float    _tiw = 1.0f, _tix = 0.0f, _tiy = 0.0f, _tiz = 0.0f;   // saved reference without its yaw
 
   // Light / LED
+  VCNL4040 _vcnl;
   bool     _light_en = false;
+  bool     _light_ok = false;
   bool     _dark_led_en = false;
   bool     _dark_led_activeHigh = true;
   uint8_t  _dark_led_pin = 1;
@@ -99,6 +237,15 @@ private:
   LokaDarkSource _dark_src = AMB;
   uint16_t _prox = 0, _amb = 0, _white = 0;
 
+  int8_t   _light_pin = -1;
+  bool     _light_poll = true;
+  volatile bool _light_irq = false;
+  static LokaMCU* _lightOwner;
+  bool     _near = false, _dark = false;
+  bool     _dark_int = false;
+  uint16_t _near_hi = 0, _dark_lo = 0, _dark_hi = 0;
+  LokaLightCb _near_cb = nullptr, _dark_cb = nullptr;
+
   bool        _rgb_en = false;
   PowerState  _pwr_state = POWER_BAT_RUN;
 
@@ -115,19 +262,33 @@ private:
   bool _tapWasTrue         = false;
 
   void imuEnable_();
+  void imuRates_();
+  uint32_t reportUs_(LokaImuQ q) const;
   void imuPoll_();
+  void imuEvent_(const sh2_SensorValue_t &v);
+  void imuFastRot_(const sh2_SensorValue_t &v);
+  void imuPush_(LokaImuQ q, uint8_t id, uint64_t us, float a, float b, float c, float d = 0.0f);
+  void imuSeq_(LokaImuQ q, uint8_t seq);
   void imuTareReset_();
+  void tareFirst_();
+  void quatUpdate_();
+  bool tareLoad_();
+  bool tareStore_();
+  void eulerUpdate_();
 
-  bool vcnlInit_();
-  bool vcnlReadU16_(uint8_t reg, uint16_t &out);
-  bool vcnlWriteU16_(uint8_t reg, uint16_t val);
   void vcnlPoll_();
+  void vcnlChannels_(bool white);
+  void lightService_();
+  void darkWindow_();
+  static void onLightInt_();
 
   static void quatMul_(float aw,float ax,float ay,float az,
                        float bw,float bx,float by,float bz,
                        float &rw,float &rx,float &ry,float &rz);
   static void quatToEulerDeg_(float w, float x, float y, float z,
-                              float &roll, float &pitch, float &yaw);
+                              float &roll, float &pitch, float &yaw, bool fast = false);
+  static float fastAtan2f_(float y, float x);
+  static float fastAsinf_(float x);
 };
 
 extern float r, p, y;       // rotation
@@ -1,59 +1,108 @@
 #include "LokaMotors.h"
 
-LokaMotor::LokaMotor(uint8_t IN1, uint8_t IN2) : _IN1(IN1), _IN2(IN2) {}
+LokaMotor::LokaMotor(uint8_t IN1, uint8_t IN2)
+: _IN1(IN1), _IN2(IN2), _maxDuty(255), _mode(MOTOR_COAST), _dead(0.0f), _slew(0.0f),
+  _target(0.0f), _out(0.0f), _lastUs(0), _periodS(0.0f), _clock(false), _stopped(false) {}
 
-void LokaMotor::Init() {
 #if defined(ARDUINO_ARCH_ESP32)
+bool LokaMotor::Init(uint32_t freqHz, uint8_t resBits) {
   pinMode(_IN1, OUTPUT);
   pinMode(_IN2, OUTPUT);
-  ledcAttach(_IN1, LOKA_PWM_BASE_FREQ, LOKA_PWM_RES_BITS);
-  ledcAttach(_IN2, LOKA_PWM_BASE_FREQ, LOKA_PWM_RES_BITS);
+  _maxDuty = (1UL << resBits) - 1;
+  const bool ok = ledcAttach(_IN1, freqHz, resBits) && ledcAttach(_IN2, freqHz, resBits);
+  apply_(0.0f);
+  _lastUs = micros();
+  _clock = false;
+  return ok;
+}
 #else
+bool LokaMotor::Init() {
   pinMode(_IN1, OUTPUT);
   pinMode(_IN2, OUTPUT);
+  apply_(0.0f);
+  _lastUs = micros();
+  _clock = false;
+  return true;
+}
 #endif
+
+void LokaMotor::Ctrl(float percent) {
+  _target = constrain(percent, -100.0f, 100.0f);
+  if (_target != 0.0f) _stopped = false;
+  if (_stopped) return;
+  if (_slew <= 0.0f) apply_(_target);
 }
 
-void LokaMotor::Ctrl(int8_t percent) {
-  if (percent > 100) percent = 100;
-  if (percent < -100) percent = -100;
+void LokaMotor::Mode(LokaMotorMode m) {
+  _mode = m;
+  if (!_stopped) apply_(_out);
+}
 
-#if defined(ARDUINO_ARCH_ESP32)
-  uint8_t duty = (uint16_t)abs(percent) * 255 / 100;
-  if (percent > 0) {
-    ledcWrite(_IN1, 0);
-    ledcWrite(_IN2, duty);
-  } else if (percent < 0) {
-    ledcWrite(_IN2, 0);
-    ledcWrite(_IN1, duty);
-  } else {
-    ledcWrite(_IN1, 0);
-    ledcWrite(_IN2, 0);
+void LokaMotor::Update() {
+  const uint32_t now = micros();
+  float dt = (now - _lastUs) * 1e-6f;
+  _lastUs = now;
+  // The first call only starts the clock. A call after a pause (a stopped LokaDrive stops
+  // calling) counts as one period, or restarts the clock before a period is known: idle time
+  // is not slew time.
+  const bool pause = _periodS > 0.0f ? dt > 2.0f * _periodS : dt > 0.1f;
+  if (!_clock) { dt = 0.0f; _clock = true; }
+  else if (pause) dt = _periodS;
+  else _periodS = dt;
+  if (_stopped) return;
+  if (_slew <= 0.0f) { apply_(_target); return; }
+
+  const float step = _slew * dt;
+  float out = _out;
+  if (_target > out + step)      out += step;
+  else if (_target < out - step) out -= step;
+  else                           out = _target;
+  apply_(out);
+}
+
+void LokaMotor::Brake() { stop_(MOTOR_BRAKE); }
+
+void LokaMotor::Coast() { stop_(MOTOR_COAST); }
+
+// The bridge is set once in the stop mode and left there: Update() and Ctrl(0) skip it
+void LokaMotor::stop_(LokaMotorMode m) {
+  _target = 0.0f;
+  _stopped = true;
+  const LokaMotorMode keep = _mode;
+  _mode = m;
+  apply_(0.0f);
+  _mode = keep;
+}
+
+// Positive drives IN2, negative IN1. Coast PWMs the driven input against a low one; brake holds
+// the driven input high and PWMs the other with the inverted duty, so the off-time shorts the motor.
+void LokaMotor::apply_(float percent) {
+  _out = percent;
+  const float mag = fabsf(percent);
+  uint32_t duty = 0;
+  if (mag > 0.0f) {
+    const float eff = _dead + mag * (100.0f - _dead) / 100.0f;
+    duty = (uint32_t)(eff * _maxDuty / 100.0f + 0.5f);
+    if (duty > _maxDuty) duty = _maxDuty;
   }
-#else
-  uint8_t duty = (uint16_t)abs(percent) * 255 / 100;
-  if (percent > 0) {
-    digitalWrite(_IN1, LOW);
-    #if defined(analogWrite)
-      analogWrite(_IN2, duty);
-    #else
-      digitalWrite(_IN2, duty > 127 ? HIGH : LOW);
-    #endif
-  } else if (percent < 0) {
-    digitalWrite(_IN2, LOW);
-    #if defined(analogWrite)
-      analogWrite(_IN1, duty);
-    #else
-      digitalWrite(_IN1, duty > 127 ? HIGH : LOW);
-    #endif
+  const uint8_t on  = (percent > 0.0f) ? _IN2 : _IN1;
+  const uint8_t off = (percent > 0.0f) ? _IN1 : _IN2;
+
+  if (_mode == MOTOR_BRAKE) {
+    write_(on, _maxDuty);
+    write_(off, _maxDuty - duty);
   } else {
-    #if defined(analogWrite)
-      analogWrite(_IN1, 0);
-      analogWrite(_IN2, 0);
-    #else
-      digitalWrite(_IN1, LOW);
-      digitalWrite(_IN2, LOW);
-    #endif
+    write_(off, 0);
+    write_(on, duty);
   }
+}
+
+void LokaMotor::write_(uint8_t pin, uint32_t duty) {
+#if defined(ARDUINO_ARCH_ESP32)
+  ledcWrite(pin, duty);
+#elif defined(analogWrite)
+  analogWrite(pin, duty);
+#else
+  digitalWrite(pin, duty > _maxDuty / 2 ? HIGH : LOW);
 #endif
 }
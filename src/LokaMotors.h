@@ -5,17 +5,55 @@
 
 #if defined(ARDUINO_ARCH_ESP32)
   #define LOKA_PWM_BASE_FREQ 20000
-  #define LOKA_PWM_RES_BITS  8
+  #define LOKA_PWM_RES_BITS  10      // 11 is the most LEDC can do at 20 kHz
 #endif
 
+// What the bridge does between PWM pulses and at 0%
+enum LokaMotorMode : uint8_t {
+  MOTOR_COAST = 0,   // fast decay, both inputs low at stop
+  MOTOR_BRAKE = 1    // slow decay, both inputs high at stop
+};
+
 class LokaMotor {
 public:
   LokaMotor(uint8_t IN1, uint8_t IN2);
-  void Init();
-  void Ctrl(int8_t percent);
+#if defined(ARDUINO_ARCH_ESP32)
+  bool Init(uint32_t freqHz = LOKA_PWM_BASE_FREQ, uint8_t resBits = LOKA_PWM_RES_BITS);
+#else
+  bool Init();
+#endif
+  void Ctrl(float percent);                 // -100..100, fractions kept down to one PWM step
+
+  void Mode(LokaMotorMode m);
+  void Deadband(float percent) { _dead = constrain(percent, 0.0f, 99.0f); }  // least duty that turns the motor
+  // Acceleration limit in %/s, 0 = off. With a limit Ctrl() only sets the target and Update()
+  // moves the output, so call Update() at a fixed rate. A call after a pause counts as one
+  // period, so idle time never turns into a jump.
+  void Slew(float percentPerSec) { _slew = percentPerSec > 0.0f ? percentPerSec : 0.0f; }
+  void Update();
+
+  // Stop now, ignoring the slew limit, and stay stopped through Update() and Ctrl(0) until a
+  // nonzero Ctrl() or the other of the two
+  void Brake();
+  void Coast();
+  bool Stopped() const { return _stopped; }
+  float Output() const { return _out; }
+  float Target() const { return _target; }
 
 private:
   uint8_t _IN1, _IN2;
+  uint32_t _maxDuty;
+  LokaMotorMode _mode;
+  float _dead, _slew;
+  float _target, _out;
+  uint32_t _lastUs;
+  float _periodS;          // last regular Update() interval, 0 until the clock runs
+  bool  _clock;            // Update() ran since Init()
+  bool  _stopped;         // Brake() or Coast() set the bridge, held until a nonzero Ctrl()
+
+  void stop_(LokaMotorMode m);
+  void apply_(float percent);
+  void write_(uint8_t pin, uint32_t duty);
 };
 
 #endif
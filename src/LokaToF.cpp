@@ -1,47 +1,227 @@
 // LokaToF.cpp
 #include "LokaToF.h"
 
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+LokaToF* LokaToF::_intOwner = nullptr;
+
+static const uint8_t kFresh = 0x80;  // _mid holds a frame the reader has not seen
+
 LokaToF::LokaToF()
-: _res(Z16), _loopHz(30), _rangeHz(30), _lastTickMs(0), _selectAll(true), _selCount(0) {
-  for (uint8_t i = 0; i < 64; ++i) { _dist[i] = -1; _mask[i] = false; }
+: _res(Z16), _loopHz(30), _rangeHz(30), _lastTickMs(0), _initMs(0), _initT0(0), _state(TOF_OFF), _outputs(VL53L5CX_OUTPUT_DISTANCE_MM), _back(1), _front(0), _mid(2), _seq(0), _intPin(-1), _intFlag(false), _intUs(0),
+#if LOKA_TOF_TASK
+  _intMux(portMUX_INITIALIZER_UNLOCKED), _wantHz(0), _taskStop(false), _taskLive(false), _task(nullptr),
+#endif
+  _selectAll(true), _selCount(0) {
+  for (uint8_t i = 0; i < 64; ++i) _mask[i] = false;
+  for (auto& f : _frames) {
+    for (uint8_t i = 0; i < 64; ++i) f.dist[i] = -1;
+    f.zones = 16; f.seq = 0; f.ms = 0; f.us = 0;
+  }
+  buildRemap_();
 }
 
 bool LokaToF::Init(LokaToFRes res) {
-  _res = res;
-  Wire.begin();
-  Wire.setClock(400000);
-  if (!_sensor.begin(0x29, Wire)) return false;
-
-  _sensor.setResolution((_res == Z16) ? 16 : 64);
-  _rangeHz = (_res == Z16) ? 30 : 15;
-  _loopHz  = _rangeHz;
-  _sensor.setRangingFrequency(_rangeHz);
-  _sensor.startRanging();
+  if (!BeginAsync(res)) return false;
+  while (!Step(50)) {
+    if (_state == TOF_FAIL) return false;
+    delay(1);
+  }
+  return true;
+}
 
-  _lastTickMs = millis();
+bool LokaToF::BeginAsync(LokaToFRes res) {
+  _res = res;
+  TwoWire& wire = LokaI2C.Begin(400000);
+  _initT0 = millis();
+  _initMs = 0;
   _selectAll = true;
   _selCount = 0;
-  return true;
+  _state = _sensor.beginAsync(0x29, wire) ? TOF_BOOT : TOF_FAIL;
+  return _state != TOF_FAIL;
+}
+
+bool LokaToF::Step(uint16_t budgetMs) {
+  switch (_state) {
+    case TOF_BOOT:
+      if (!_sensor.initStep(budgetMs)) { _state = TOF_FAIL; break; }
+      if (_sensor.isInitDone()) { _initMs = millis() - _initT0; _state = TOF_RES; }
+      break;
+    // one sensor command per step, each is a short DCI round trip
+    case TOF_RES:
+      _sensor.setResolution((_res == Z16) ? 16 : 64);
+      buildRemap_();
+      _rangeHz = (_res == Z16) ? 30 : 15;
+      _loopHz  = _rangeHz;
+      _state = TOF_FREQ;
+      break;
+    case TOF_FREQ:
+      _sensor.setRangingFrequency(_rangeHz);
+      _state = TOF_START;
+      break;
+    case TOF_START:
+      _sensor.setOutputProfile(_outputs);
+      _sensor.startRanging();
+      { uint32_t us; takeInt_(us); }  // drop edges seen while booting
+      _lastTickMs = millis();
+      _state = TOF_READY;
+      break;
+    default:
+      break;
+  }
+  return _state == TOF_READY;
 }
 
 void LokaToF::Run(uint8_t hz) {
   if (_res == Z16) { if (hz < 1) hz = 1; if (hz > 60) hz = 60; }
   else              { if (hz < 1) hz = 1; if (hz > 15) hz = 15; }
 
+#if LOKA_TOF_TASK
+  // the task owns the bus, only pass the rate on
+  if (_taskLive) { _wantHz.store(hz); return; }
+#endif
+  if (_state != TOF_READY) { Step(); return; }
+
   _loopHz = hz;
   if (_rangeHz != _loopHz) { _sensor.setRangingFrequency(_loopHz); _rangeHz = _loopHz; }
 
+  // INT mode: the sensor paces frames, no bus traffic until it signals
+  if (_intPin >= 0) {
+    uint32_t us;
+    if (takeInt_(us)) readFrame_(us);
+    return;
+  }
+
   const uint32_t periodMs = 1000UL / _loopHz;
   if (millis() - _lastTickMs < periodMs) return;
   _lastTickMs = millis();
 
-  if (_sensor.isDataReady()) readFrame_();
+  if (_sensor.isDataReady()) readFrame_(micros());
 }
 
-void LokaToF::readFrame_() {
-  VL53L5CX_ResultsData frame;
-  if (!_sensor.getRangingData(&frame)) return;
+void IRAM_ATTR LokaToF::onInt_() {
+  LokaToF* self = _intOwner;
+  if (!self) return;
+#if LOKA_TOF_TASK
+  portENTER_CRITICAL_ISR(&self->_intMux);
+  self->_intUs = micros();
+  self->_intFlag = true;
+  portEXIT_CRITICAL_ISR(&self->_intMux);
+  TaskHandle_t task = self->_task.load();
+  if (task) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+#else
+  self->_intUs = micros();
+  self->_intFlag = true;
+#endif
+}
+
+#if LOKA_TOF_TASK
+bool LokaToF::StartTask(uint8_t core, uint8_t prio) {
+  if (_taskLive) return true;
+  _taskStop = false;
+  _wantHz.store(0);
+  _taskLive = true;
+  TaskHandle_t handle;
+  if (xTaskCreatePinnedToCore(taskEntry_, "LokaToF", 4096, this, prio, &handle, core) == pdPASS) return true;
+  _taskLive = false;
+  return false;
+}
+
+void LokaToF::StopTask() {
+  if (!_taskLive) return;
+  _taskStop = true;
+  while (_taskLive) delay(1);  // task clears it at a bus-idle point
+}
+
+void LokaToF::taskEntry_(void* arg) {
+  static_cast<LokaToF*>(arg)->taskLoop_();
+}
 
+void LokaToF::taskLoop_() {
+  _task = xTaskGetCurrentTaskHandle();
+  while (!_taskStop) {
+    if (_state != TOF_READY) {
+      if (Step(20)) continue;
+      if (_state == TOF_FAIL || _state == TOF_OFF) break;
+      vTaskDelay(pdMS_TO_TICKS(2));
+      continue;
+    }
+
+    const uint8_t hz = _wantHz.exchange(0);
+    if (hz && hz != _rangeHz) { _sensor.setRangingFrequency(hz); _rangeHz = hz; _loopHz = hz; }
+
+    uint32_t us;
+    if (_intPin >= 0) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+      if (takeInt_(us)) readFrame_(us);
+    } else {
+      if (_sensor.isDataReady()) readFrame_(micros());
+      vTaskDelay(pdMS_TO_TICKS(2));
+    }
+  }
+  _task = nullptr;
+  _taskLive = false;
+  vTaskDelete(nullptr);
+}
+#endif
+
+void LokaToF::UseInt(uint8_t pin) {
+  UsePolling();
+  _intPin = pin;
+  _intFlag = false;
+  _intOwner = this;
+  pinMode(pin, INPUT_PULLUP);  // INT is open-drain, active low
+  attachInterrupt(digitalPinToInterrupt(pin), onInt_, FALLING);
+}
+
+void LokaToF::UsePolling() {
+  if (_intPin < 0) return;
+  detachInterrupt(digitalPinToInterrupt(_intPin));
+  if (_intOwner == this) _intOwner = nullptr;
+  _intPin = -1;
+}
+
+bool LokaToF::takeInt_(uint32_t& us) {
+#if LOKA_TOF_TASK
+  // noInterrupts() only masks this core, the edge may be handled on the other one
+  portENTER_CRITICAL(&_intMux);
+  const bool taken = _intFlag;
+  us = _intUs;
+  _intFlag = false;
+  portEXIT_CRITICAL(&_intMux);
+  return taken;
+#else
+  if (!_intFlag) return false;
+  noInterrupts();
+  us = _intUs;
+  _intFlag = false;
+  interrupts();
+  return true;
+#endif
+}
+
+bool LokaToF::Outputs(uint32_t mask) {
+#if LOKA_TOF_TASK
+  if (_taskLive) return false;  // set before StartTask()
+#endif
+  // distance is always kept, readFrame_ needs it
+  mask |= VL53L5CX_OUTPUT_DISTANCE_MM;
+  if (mask == _outputs) return true;
+  _outputs = mask;
+  if (_state != TOF_READY) return true;  // applied when ranging starts
+
+  _sensor.stopRanging();
+  const bool ok = _sensor.setOutputProfile(_outputs);
+  return _sensor.startRanging() && ok;
+}
+
+void LokaToF::buildRemap_() {
   const uint8_t w = width_();
   const uint8_t h = w;
   const uint8_t n = count_();
@@ -49,12 +229,42 @@ void LokaToF::readFrame_() {
   for (uint8_t i = 0; i < n; ++i) {
     uint8_t r = i / w;
     uint8_t c = i % w;
-    uint8_t idx = (h - 1 - r) * w + (w - 1 - c);
-    int16_t v = (int16_t)frame.distance_mm[i];
-    _dist[idx] = (v > 0) ? v : -1;
+    _remap[i] = (h - 1 - r) * w + (w - 1 - c);
   }
 }
 
+void LokaToF::readFrame_(uint32_t us) {
+  // decode into the writer slot, then swap it with the handover slot
+  LokaToFFrame& f = _frames[_back];
+  if (!_sensor.getRangingDistance(f.dist, _remap, -1)) return;
+
+  f.zones = count_();
+  f.seq = ++_seq;
+  f.ms = millis();
+  f.us = us;
+#if LOKA_TOF_TASK
+  _back = _mid.exchange(_back | kFresh, std::memory_order_acq_rel) & 3;
+#else
+  const uint8_t mid = _mid & 3;
+  _mid = _back | kFresh;
+  _back = mid;
+#endif
+}
+
+const LokaToFFrame& LokaToF::Frame() const {
+#if LOKA_TOF_TASK
+  if (_mid.load(std::memory_order_acquire) & kFresh)
+    _front = _mid.exchange(_front, std::memory_order_acq_rel) & 3;
+#else
+  if (_mid & kFresh) {
+    const uint8_t mid = _mid & 3;
+    _mid = _front;
+    _front = mid;
+  }
+#endif
+  return _frames[_front];
+}
+
 void LokaToF::Zones() {
   _selectAll = true;
   _selCount = 0;
@@ -78,6 +288,7 @@ void LokaToF::buildMask_() {
 }
 
 void LokaToF::printGrid_() {
+  const LokaToFFrame& f = Frame();  // one frame for the whole grid
   const uint8_t w = width_();
   const uint8_t h = w;
   for (int y = w * (h - 1); y >= 0; y -= w) {
@@ -86,7 +297,7 @@ void LokaToF::printGrid_() {
       if (!_mask[id]) {
         Serial.print('.');
       } else {
-        int v = _dist[id];
+        int v = f.dist[id];
         if (v <= 0) Serial.print('-'); else Serial.print(v);
       }
       if (x < w - 1) Serial.print('\t');
@@ -96,7 +307,19 @@ void LokaToF::printGrid_() {
 }
 
 void LokaToF::PrintZones() {
-  if (_sensor.isDataReady()) readFrame_();
+#if LOKA_TOF_TASK
+  if (_taskLive) {
+    buildMask_();
+    printGrid_();
+    Serial.println();
+    return;
+  }
+#endif
+  if (_state == TOF_READY) {
+    uint32_t us;
+    if (_intPin >= 0) { if (takeInt_(us)) readFrame_(us); }
+    else if (_sensor.isDataReady()) readFrame_(micros());
+  }
   buildMask_();
   printGrid_();
   Serial.println();
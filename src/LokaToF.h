@@ -3,19 +3,53 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include "tof/SparkFun_VL53L5CX_Library.h"
+#include "LokaBus.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <atomic>
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #define LOKA_TOF_TASK 1
+#endif
 
 enum LokaToFRes : uint8_t { Z16, Z64 };
+// One decoded frame, already in Loka orientation (zone 0 = top-right)
+struct LokaToFFrame {
+  int16_t dist[64];   // mm, -1 when no target
+  uint8_t zones;      // 16 or 64
+  uint32_t seq;       // frames read since boot
+  uint32_t ms;        // millis() at read
+  uint32_t us;        // micros() of the INT edge, or of the read when polling
+};
+
+enum LokaToFState : uint8_t { TOF_OFF, TOF_BOOT, TOF_RES, TOF_FREQ, TOF_START, TOF_READY, TOF_FAIL };
 
 class LokaToF {
 public:
   LokaToF();
   bool Init(LokaToFRes res);
+  bool BeginAsync(LokaToFRes res);       // start boot, then call Step() from loop()
+  bool Step(uint16_t budgetMs = 5);      // advance boot, true once ranging
+  bool Ready() const { return _state == TOF_READY; }
+  LokaToFState State() const { return _state; }
   void Run(uint8_t hz = 30);
   void Zones();
   void Zones(std::initializer_list<uint8_t> ids);
   template<typename... Z>
   void Zones(Z... z) { Zones(std::initializer_list<uint8_t>{ static_cast<uint8_t>(z)... }); }
   void PrintZones();
+  const LokaToFFrame& Frame() const;     // newest frame, no copy; valid until the next Frame()
+  bool Outputs(uint32_t mask);           // VL53L5CX_OUTPUT_* blocks to stream, distance only by default
+  void UseInt(uint8_t pin);              // read frames on the INT edge instead of polling I2C
+  void UsePolling();
+#if LOKA_TOF_TASK
+  bool StartTask(uint8_t core = 0, uint8_t prio = 2); // sensor owned by a pinned task, Run() only hands over frames
+  void StopTask();
+  bool TaskRunning() const { return _taskLive.load(); }
+#endif
+
+  uint32_t InitMs() const { return _initMs; }              // time spent in sensor boot
+  uint32_t UploadRate() { return _sensor.getUploadRate(); } // firmware upload, bytes/s
 
 private:
   SparkFun_VL53L5CX _sensor;
@@ -23,7 +57,34 @@ private:
   uint8_t _loopHz;
   uint8_t _rangeHz;
   uint32_t _lastTickMs;
-  int16_t _dist[64];
+  uint32_t _initMs;
+  uint32_t _initT0;
+  LokaToFState _state;
+  uint32_t _outputs;
+  // triple buffer: writer fills _back, reader holds _front, _mid is handed over
+  LokaToFFrame _frames[3];
+  uint8_t _back;
+  mutable uint8_t _front;
+#if LOKA_TOF_TASK
+  mutable std::atomic<uint8_t> _mid;
+#else
+  mutable uint8_t _mid;
+#endif
+  uint32_t _seq;
+  uint8_t _remap[64];        // sensor zone -> Loka zone
+  int16_t _intPin;           // -1 = poll isDataReady()
+  volatile bool _intFlag;
+  volatile uint32_t _intUs;
+  static LokaToF* _intOwner;
+#if LOKA_TOF_TASK
+  portMUX_TYPE _intMux;          // guards _intFlag/_intUs, the ISR may run on the other core
+  std::atomic<uint8_t> _wantHz;  // rate change for the task, 0 = none
+  std::atomic<bool> _taskStop;
+  std::atomic<bool> _taskLive;   // from StartTask() until the task has let go of the sensor
+  std::atomic<TaskHandle_t> _task;  // set by the task itself, null until it runs
+  static void taskEntry_(void* arg);
+  void taskLoop_();
+#endif
   bool _selectAll;
   bool _mask[64];
   uint8_t _sel[64];
@@ -32,7 +93,10 @@ private:
   uint8_t count_() const { return (_res == Z16) ? 16 : 64; }
   uint8_t width_() const { return (_res == Z16) ? 4 : 8; }
 
-  void readFrame_();
+  void readFrame_(uint32_t us);
+  bool takeInt_(uint32_t& us);
+  static void onInt_();
+  void buildRemap_();
   void buildMask_();
   void printGrid_();
 };
@@ -1,4 +1,9 @@
 #include "BNO085.h"
+#include "../LokaBus.h"
+#if defined(ARDUINO_ARCH_ESP32)
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#endif
 
 static TwoWire *_i2cPort = NULL;  //The generic connection to user's chosen I2C hardware
 static uint8_t _address = 0x4A;   //Keeps track of I2C address. setI2CAddress changes this.
@@ -6,16 +11,40 @@ static uint8_t _address = 0x4A;   //Keeps track of I2C address. setI2CAddress ch
 static sh2_SensorValue_t *_sensor_value = NULL;
 static bool _reset_occurred = false;
 
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+//Events from the SH-2 callback, single producer (sh2_service) / single consumer (popSensorEvent).
+//Kept raw: decoding happens on pop, so the callback stays short.
+//The indices run free and wrap at 65536, so only a power of two keeps head % size in step
+static_assert(BNO085_EVENT_QUEUE > 0 && (BNO085_EVENT_QUEUE & (BNO085_EVENT_QUEUE - 1)) == 0,
+              "BNO085_EVENT_QUEUE must be a power of two");
+static sh2_SensorEvent_t _events[BNO085_EVENT_QUEUE];
+static uint16_t _eventHead = 0;          //Written only by sensorHandler
+static uint16_t _eventTail = 0;          //Written only by popSensorEvent
+static uint32_t _eventOverruns = 0;
+
+static int8_t _intPin = -1;              //H_INTN pin, -1 = poll the bus
+static volatile bool _intFlag = false;   //Set by the ISR on every falling edge
+static volatile uint32_t _intUs = 0;     //Time of that edge, hal_getTimeUs timebase
+#if defined(ARDUINO_ARCH_ESP32)
+static portMUX_TYPE _intMux = portMUX_INITIALIZER_UNLOCKED;  //Guards _intFlag/_intUs, the ISR may run on the other core
+#endif
+static void IRAM_ATTR hal_onInt();
+static bool hal_takeInt(uint32_t *us);
+
 static int i2chal_write(sh2_Hal_t *self, uint8_t *pBuffer, unsigned len);
 static int i2chal_read(sh2_Hal_t *self, uint8_t *pBuffer, unsigned len, uint32_t *t_us);
 static void i2chal_close(sh2_Hal_t *self);
 static int i2chal_open(sh2_Hal_t *self);
 
 static uint32_t hal_getTimeUs(sh2_Hal_t *self);
+static uint64_t hal_getTimeUs64(sh2_Hal_t *self);
 static void hal_callback(void *cookie, sh2_AsyncEvent_t *pEvent);
 static void sensorHandler(void *cookie, sh2_SensorEvent_t *pEvent);
 
-size_t _maxBufferSize = 32;
+size_t _maxBufferSize = BNO085_I2C_BUFFER_SIZE;
 size_t maxBufferSize();
 
 
@@ -30,6 +59,7 @@ bool BNO085::begin(TwoWire &wirePort) {
   _HAL.read = i2chal_read;
   _HAL.write = i2chal_write;
   _HAL.getTimeUs = hal_getTimeUs;
+  _HAL.getTimeUs64 = hal_getTimeUs64;
 
   return _init();
 }
@@ -51,30 +81,47 @@ bool BNO085::_init(int32_t sensor_id) {
   }
 
   // Register sensor listener
-  sh2_setSensorCallback(sensorHandler, NULL);
+  _sensor_value = &sensorValue;
+  sh2_setSensorCallback(sensorHandler, this);
 
   return true;
 }
 
+//Pops the next report into sensorValue, reading the bus only when the queue is empty
 bool BNO085::getSensorEvent() {
   _sensor_value = &sensorValue;
 
-  _i2cPort->beginTransmission((uint8_t)_address);
-
-  _sensor_value->timestamp = 0;
+  if (sensorEventsAvailable() == 0) {
+    _i2cPort->beginTransmission((uint8_t)_address);
+    sh2_service();
+  }
 
-  sh2_service();
+  return popSensorEvent(sensorValue);
+}
 
-  if (_sensor_value->timestamp == 0 && _sensor_value->sensorId != SH2_GYRO_INTEGRATED_RV) {
-    // no new events
-    return false;
+bool BNO085::popSensorEvent(sh2_SensorValue_t &value) {
+  uint16_t tail = _eventTail;
+  while (tail != __atomic_load_n(&_eventHead, __ATOMIC_ACQUIRE)) {
+    int rc = sh2_decodeSensorEvent(&value, &_events[tail % BNO085_EVENT_QUEUE]);
+    tail++;
+    __atomic_store_n(&_eventTail, tail, __ATOMIC_RELEASE);
+    if (rc == SH2_OK) {
+      return true;
+    }
   }
+  return false;
+}
 
-  return true;
+uint16_t BNO085::sensorEventsAvailable() {
+  return (uint16_t)(__atomic_load_n(&_eventHead, __ATOMIC_ACQUIRE) - _eventTail);
+}
+
+uint32_t BNO085::getEventOverruns() {
+  return _eventOverruns;
 }
 
 bool BNO085::enableReport(sh2_SensorId_t sensorId, uint32_t interval_us,
-                          uint32_t sensorSpecific) {
+                          uint32_t sensorSpecific, uint32_t batchInterval_us) {
   static sh2_SensorConfig_t config;
 
   // These sensor options are disabLED or not used in most cases
@@ -83,7 +130,7 @@ bool BNO085::enableReport(sh2_SensorId_t sensorId, uint32_t interval_us,
   config.changeSensitivityRelative = false;
   config.alwaysOnEnabled = false;
   config.changeSensitivity = 0;
-  config.batchInterval_us = 0;
+  config.batchInterval_us = batchInterval_us;
   config.sensorSpecific = sensorSpecific;
 
   config.reportInterval_us = interval_us;
@@ -97,6 +144,83 @@ bool BNO085::enableReport(sh2_SensorId_t sensorId, uint32_t interval_us,
   return true;
 }
 
+bool BNO085::flushBatch(sh2_SensorId_t sensorId) {
+  return sh2_flush(sensorId) == SH2_OK;
+}
+
+void BNO085::setEventCallback(BNO085_EventCallback callback, void *cookie) {
+  _eventCallback = callback;
+  _eventCookie = cookie;
+}
+
+bool bno085_hasEventCallback(BNO085 *imu) {
+  return imu != NULL && imu->_eventCallback != NULL;
+}
+
+void bno085_dispatchEvent(BNO085 *imu, const sh2_SensorValue_t *value) {
+  if (imu != NULL && imu->_eventCallback != NULL) {
+    imu->_eventCallback(imu->_eventCookie, value);
+  }
+}
+
+//Service on the H_INTN data-ready line: the HAL only reads when the hub asks for it
+bool BNO085::useInterrupt(uint8_t pin) {
+  usePolling();
+  pinMode(pin, INPUT_PULLUP);
+  uint32_t us;
+  hal_takeInt(&us);
+  _intPin = pin;
+  attachInterrupt(digitalPinToInterrupt(pin), hal_onInt, FALLING);
+  return true;
+}
+
+void BNO085::usePolling() {
+  if (_intPin < 0) return;
+  detachInterrupt(digitalPinToInterrupt(_intPin));
+  _intPin = -1;
+  uint32_t us;
+  hal_takeInt(&us);
+}
+
+//True when a report is waiting; always true in polling mode
+bool BNO085::dataReady() {
+  if (_intPin < 0) return true;
+  return _intFlag || digitalRead(_intPin) == LOW;
+}
+
+static void IRAM_ATTR hal_onInt() {
+#if defined(ARDUINO_ARCH_ESP32)
+  portENTER_CRITICAL_ISR(&_intMux);
+  _intUs = micros();
+  _intFlag = true;
+  portEXIT_CRITICAL_ISR(&_intMux);
+#else
+  _intUs = micros();
+  _intFlag = true;
+#endif
+}
+
+//Takes the latched edge and its time in one step: an edge landing in between would otherwise be
+//lost, or have its time paired with the earlier flag
+static bool hal_takeInt(uint32_t *us) {
+#if defined(ARDUINO_ARCH_ESP32)
+  //noInterrupts() only masks this core, the edge may be handled on the other one
+  portENTER_CRITICAL(&_intMux);
+  const bool taken = _intFlag;
+  *us = _intUs;
+  _intFlag = false;
+  portEXIT_CRITICAL(&_intMux);
+  return taken;
+#else
+  if (!_intFlag) return false;
+  noInterrupts();
+  *us = _intUs;
+  _intFlag = false;
+  interrupts();
+  return true;
+#endif
+}
+
 static int i2chal_open(sh2_Hal_t *self) {
 
   uint8_t softreset_pkt[] = { 5, 0, 1, 0, 1 };
@@ -118,55 +242,58 @@ static void i2chal_close(sh2_Hal_t *self) {
 }
 
 static int i2chal_read(sh2_Hal_t *self, uint8_t *pBuffer, unsigned len, uint32_t *t_us) {
-  uint8_t header[4];
-  if (!I2CRead(_address, header, 4)) {
+  //Arrival time of the packet, before the transfer adds its own latency
+  *t_us = hal_getTimeUs(self);
+  if (_intPin >= 0) {
+    //H_INTN stays low until the host reads, so high with no latched edge means nothing to fetch
+    uint32_t edge_us;
+    if (hal_takeInt(&edge_us)) {
+      *t_us = edge_us;
+    } else if (digitalRead(_intPin) == HIGH) {
+      return 0;
+    }
+  }
+  if (len < 4 || !I2CRead(_address, pBuffer, 4)) {
     return 0;
   }
 
-  uint16_t packet_size = (uint16_t)header[0] | (uint16_t)header[1] << 8;
+  uint16_t packet_size = (uint16_t)pBuffer[0] | (uint16_t)pBuffer[1] << 8;
   // Unset the "continue" bit
   packet_size &= ~0x8000;
 
-
   size_t i2c_buffer_max = maxBufferSize();
 
   if (packet_size > len) {
     return 0;
   }
-  uint16_t cargo_remaining = packet_size;
-  uint8_t i2c_buffer[i2c_buffer_max];
-  uint16_t read_size;
-  uint16_t cargo_read_amount = 0;
-  bool first_read = true;
-
-  while (cargo_remaining > 0) {
-    if (first_read) {
-      read_size = min(i2c_buffer_max, (size_t)cargo_remaining);
+
+  // Every read goes straight into pBuffer. The first one starts at the header. Each later one
+  // repeats the 4 byte header, so it lands 4 bytes early and the cargo it covers is put back.
+  uint16_t pos = 0;
+  while (pos < packet_size) {
+    uint8_t *dst;
+    uint8_t saved[4];
+    uint16_t read_size;
+
+    if (pos == 0) {
+      dst = pBuffer;
+      read_size = min(i2c_buffer_max, (size_t)packet_size);
     } else {
-      read_size = min(i2c_buffer_max, (size_t)cargo_remaining + 4);
+      dst = pBuffer + pos - 4;
+      read_size = min(i2c_buffer_max, (size_t)(packet_size - pos) + 4);
+      memcpy(saved, dst, 4);
     }
 
-    if (!I2CRead(_address, i2c_buffer, read_size)) {
+    if (!I2CRead(_address, dst, read_size)) {
       return 0;
     }
 
-    if (first_read) {
-      // The first time we're saving the "original" header, so include it in the
-      // cargo count
-      cargo_read_amount = read_size;
-      memcpy(pBuffer, i2c_buffer, cargo_read_amount);
-      first_read = false;
+    if (pos == 0) {
+      pos = read_size;
     } else {
-      // this is not the first read, so copy from 4 bytes after the beginning of
-      // the i2c buffer to skip the header included with every new i2c read and
-      // don't include the header in the amount of cargo read
-      cargo_read_amount = read_size - 4;
-      memcpy(pBuffer, i2c_buffer + 4, cargo_read_amount);
+      memcpy(dst, saved, 4);
+      pos += read_size - 4;
     }
-    // advance our pointer by the amount of cargo read
-    pBuffer += cargo_read_amount;
-    // mark the cargo as received
-    cargo_remaining -= cargo_read_amount;
   }
   return packet_size;
 }
@@ -184,10 +311,40 @@ static int i2chal_write(sh2_Hal_t *self, uint8_t *pBuffer, unsigned len) {
 }
 
 
+//micros() extended to 64 bits. getTimeUs() may be called from any task while sh2_service runs.
+//On ESP32 the timer is 64-bit already and micros() is its low half. Elsewhere the wrap count
+//is kept with interrupts off, which covers one core, and needs a call at least every 71
+//minutes; sh2_service makes them constantly.
+static uint64_t hal_micros64() {
+#if defined(ARDUINO_ARCH_ESP32)
+  return (uint64_t)esp_timer_get_time();
+#else
+  static uint32_t last_us = 0;
+  static uint32_t wraps = 0;
+  noInterrupts();
+  uint32_t now = micros();
+  if (now < last_us) {
+    wraps++;
+  }
+  last_us = now;
+  const uint64_t us = ((uint64_t)wraps << 32) | now;
+  interrupts();
+  return us;
+#endif
+}
+
 static uint32_t hal_getTimeUs(sh2_Hal_t *self) {
-  uint32_t t = millis() * 1000;
-  // Serial.print("I2C HAL get time: %d\n", t);
-  return t;
+  return (uint32_t)hal_micros64();
+}
+
+//Event timestamps are extended from this, so they share hal_micros64's wrap count
+static uint64_t hal_getTimeUs64(sh2_Hal_t *self) {
+  return hal_micros64();
+}
+
+//Current time on the same timebase as getTimeStamp()
+uint64_t BNO085::getTimeUs() {
+  return hal_micros64();
 }
 
 static void hal_callback(void *cookie, sh2_AsyncEvent_t *pEvent) {
@@ -200,16 +357,29 @@ static void hal_callback(void *cookie, sh2_AsyncEvent_t *pEvent) {
 
 // Handle sensor events.
 static void sensorHandler(void *cookie, sh2_SensorEvent_t *event) {
-  int rc;
-
-  // Serial.println("Got an event!");
+  // A callback takes every report directly, decoded into sensorValue for the getters
+  if (bno085_hasEventCallback((BNO085 *)cookie)) {
+    if (sh2_decodeSensorEvent(_sensor_value, event) == SH2_OK) {
+      bno085_dispatchEvent((BNO085 *)cookie, _sensor_value);
+    }
+    return;
+  }
 
-  rc = sh2_decodeSensorEvent(_sensor_value, event);
-  if (rc != SH2_OK) {
-    //Serial.println("BNO085 - Error decoding sensor event");
-    _sensor_value->timestamp = 0;
+  // Otherwise queue it: a batched packet carries several reports and each must survive
+  uint16_t head = _eventHead;
+  if ((uint16_t)(head - __atomic_load_n(&_eventTail, __ATOMIC_ACQUIRE)) >= BNO085_EVENT_QUEUE) {
+    _eventOverruns++;  //Full: keep the older reports, drop this one
     return;
   }
+  _events[head % BNO085_EVENT_QUEUE] = *event;
+  __atomic_store_n(&_eventHead, (uint16_t)(head + 1), __ATOMIC_RELEASE);
+}
+
+//True once after the hub reset itself; its report configuration is gone
+bool BNO085::wasReset() {
+  bool reset = _reset_occurred;
+  _reset_occurred = false;
+  return reset;
 }
 
 //Return the sensorID
@@ -225,15 +395,16 @@ bool BNO085::isConnected() {
 }
 
 bool I2CWrite(uint8_t add, uint8_t *buffer, size_t size) {
-  Wire.beginTransmission(add);
+  LokaBusLock lock(LokaI2C, BUS_IMU);
+  _i2cPort->beginTransmission(add);
   // Write the data buffer
-  if (Wire.write(buffer, size) != size) {
+  if (_i2cPort->write(buffer, size) != size) {
     // If the number of bytes written is not equal to the length, return false
-    Wire.endTransmission();  // Ensure to end transmission even if writing fails
+    _i2cPort->endTransmission();  // Ensure to end transmission even if writing fails
     return false;
   }
 
-  if (Wire.endTransmission() == 0) {
+  if (_i2cPort->endTransmission() == 0) {
     return true;
   } else {
     return false;
@@ -242,6 +413,7 @@ bool I2CWrite(uint8_t add, uint8_t *buffer, size_t size) {
 
 
 bool I2CRead(uint8_t add, uint8_t *buffer, size_t size) {
+  LokaBusLock lock(LokaI2C, BUS_IMU);
   size_t pos = 0;
   while (pos < size) {
     size_t read_size;
@@ -251,14 +423,14 @@ bool I2CRead(uint8_t add, uint8_t *buffer, size_t size) {
       read_size = size - pos;
     }
 
-    size_t recv = Wire.requestFrom(add, read_size);
+    size_t recv = _i2cPort->requestFrom(add, read_size);
 
-    if (recv != size) {
+    if (recv != read_size) {
       return false;
     }
 
-    for (uint16_t i = 0; i < size; i++) {
-      buffer[i] = Wire.read();
+    for (size_t i = 0; i < read_size; i++) {
+      buffer[pos + i] = _i2cPort->read();
     }
     pos += read_size;
   }
@@ -269,6 +441,17 @@ size_t maxBufferSize() {
   return _maxBufferSize;
 }
 
+//An SHTP continuation needs room for its 4 byte header plus cargo
+void BNO085::setI2CBufferSize(size_t size) {
+  if (size < 8) size = 8;
+  if (size > BNO085_I2C_BUFFER_SIZE) size = BNO085_I2C_BUFFER_SIZE;
+  _maxBufferSize = size;
+}
+
+size_t BNO085::getI2CBufferSize() {
+  return _maxBufferSize;
+}
+
 
 float BNO085::getRot_I() {
   return _sensor_value->un.rotationVector.i;
@@ -372,7 +555,7 @@ float BNO085::getGyroZ() {
 
 //Return the gyro component
 uint8_t BNO085::getGyroAccuracy() {
-  return (gyroAccuracy);
+  return _sensor_value->status;
 }
 
 //Return the gyro component
@@ -580,6 +763,11 @@ bool BNO085::enableGameRotationVector(uint16_t timeBetweenReports) {
   return enableReport(SH2_GAME_ROTATION_VECTOR, timeBetweenReports);
 }
 
+//Gyro-integrated RV: low latency orientation at up to 1 kHz, on its own SHTP channel
+bool BNO085::enableGyroIntegratedRotationVector(uint16_t timeBetweenReports) {
+  return enableReport(SH2_GYRO_INTEGRATED_RV, (uint32_t)timeBetweenReports * 1000);  // ms to us
+}
+
 //Sends the packet to enable the ar/vr stabilized rotation vector
 bool BNO085::enableARVRStabilizedGameRotationVector(uint16_t timeBetweenReports) {
   timeBetweenReports = timeBetweenReports * 1000;  // ms to us
@@ -717,3 +905,21 @@ bool BNO085::saveCalibration() {
   }
   return true;
 }
+
+//Let the hub write its dynamic calibration to flash on its own, restored at every boot
+bool BNO085::setCalibrationAutoSave(bool enabled) {
+  int status = sh2_setDcdAutoSave(enabled);
+  if (status != SH2_OK) {
+    return false;
+  }
+  return true;
+}
+
+//Erase the saved calibration; the hub resets and starts calibrating from scratch
+bool BNO085::clearCalibration() {
+  int status = sh2_clearDcdAndReset();
+  if (status != SH2_OK) {
+    return false;
+  }
+  return true;
+}
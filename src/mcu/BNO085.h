@@ -72,6 +72,21 @@
 #define TARE_AR_VR_STABILIZED_ROTATION_VECTOR 4
 #define TARE_AR_VR_STABILIZED_GAME_ROTATION_VECTOR 5
 
+//Largest single I2C transfer: the platform's real Wire buffer when known (ESP32: 128 bytes), 32 otherwise
+#if defined(I2C_BUFFER_LENGTH) && (I2C_BUFFER_LENGTH <= 255)
+#define BNO085_I2C_BUFFER_SIZE I2C_BUFFER_LENGTH
+#else
+#define BNO085_I2C_BUFFER_SIZE 32
+#endif
+
+//Reports held between sh2_service() and popSensorEvent(), power of two
+#ifndef BNO085_EVENT_QUEUE
+#define BNO085_EVENT_QUEUE 32
+#endif
+
+//Called once for every decoded report, including each report of a batched packet. Bypasses the event queue.
+typedef void (*BNO085_EventCallback)(void *cookie, const sh2_SensorValue_t *value);
+
 bool I2CWrite(uint8_t add, uint8_t *buffer, size_t size);
 bool I2CRead(uint8_t add, uint8_t *buffer, size_t size);
 
@@ -79,7 +94,12 @@ class BNO085
 {
 public:
 	bool begin(TwoWire &wirePort = Wire); 
+	void setI2CBufferSize(size_t size); //Chunk size of I2C reads/writes, capped at BNO085_I2C_BUFFER_SIZE
+	size_t getI2CBufferSize();
 	bool isConnected();
+	bool useInterrupt(uint8_t pin); //Read only when H_INTN signals data; its edge time becomes the arrival time
+	void usePolling();
+	bool dataReady();
 
     sh2_ProductIds_t prodIds; ///< The product IDs returned by the sensor
 	sh2_SensorValue_t sensorValue;
@@ -87,11 +107,18 @@ public:
 
 	uint8_t getResetReason(); // returns prodIds->resetCause
 
-    bool enableReport(sh2_SensorId_t sensor, uint32_t interval_us = 10000, uint32_t sensorSpecific = 0);
+    bool enableReport(sh2_SensorId_t sensor, uint32_t interval_us = 10000, uint32_t sensorSpecific = 0,
+                      uint32_t batchInterval_us = 0); //batchInterval_us > 0 lets the hub FIFO hold reports that long
+    bool flushBatch(sh2_SensorId_t sensor); //Deliver the sensor's batched reports now
+    void setEventCallback(BNO085_EventCallback callback, void *cookie = NULL);
     bool getSensorEvent();
+    bool popSensorEvent(sh2_SensorValue_t &value); //Oldest queued report, no bus access
+    uint16_t sensorEventsAvailable();
+    uint32_t getEventOverruns(); //Reports dropped because the queue was full
 	uint8_t getSensorEventID();
 
 	bool softReset();	  //Try to reset the IMU via software
+	bool wasReset();	  //Hub reset since the last call, reports must be enabled again
 	bool serviceBus(void);	
 	uint8_t resetReason(); //Query the IMU for the reason it last reset
 	bool modeOn();	  //Use the executable channel to turn the BNO on
@@ -101,6 +128,7 @@ public:
 	bool enableGeomagneticRotationVector(uint16_t timeBetweenReports = 10);
 	bool enableGameRotationVector(uint16_t timeBetweenReports = 10);
 	bool enableARVRStabilizedRotationVector(uint16_t timeBetweenReports);
+	bool enableGyroIntegratedRotationVector(uint16_t timeBetweenReports = 1);
 	bool enableARVRStabilizedGameRotationVector(uint16_t timeBetweenReports);
 	bool enableAccelerometer(uint16_t timeBetweenReports = 10);
 	bool enableLinearAccelerometer(uint16_t timeBetweenReports = 10);
@@ -163,13 +191,16 @@ public:
 
 	bool setCalibrationConfig(uint8_t sensors);
 	bool saveCalibration();
+	bool setCalibrationAutoSave(bool enabled = true);
+	bool clearCalibration();
 
 	bool tareNow(bool zAxis=false, sh2_TareBasis_t basis=SH2_TARE_BASIS_ROTATION_VECTOR);
 	bool saveTare();
 	bool clearTare();
 	
 	uint8_t getTapDetector();
-	uint64_t getTimeStamp();
+	uint64_t getTimeStamp(); //Sample time in us, 64-bit micros() timebase
+	uint64_t getTimeUs();	  //Current time on the same timebase
 	uint16_t getStepCount();
 	uint8_t getStabilityClassifier();
 	uint8_t getActivityClassifier();
@@ -219,6 +250,11 @@ private:
 	Stream *_debugPort;			 //The stream to send debug messages to if enabLED. Usually Serial.
 	bool _printDebug = false; //Flag to print debugging variables
 
+	BNO085_EventCallback _eventCallback = NULL;
+	void *_eventCookie = NULL;
+	friend bool bno085_hasEventCallback(BNO085 *imu);
+	friend void bno085_dispatchEvent(BNO085 *imu, const sh2_SensorValue_t *value);
+
 	//These are the raw sensor values (without Q applied) pulLED from the user requested Input Report
 	uint16_t rawAccelX, rawAccelY, rawAccelZ, accelAccuracy;
 	uint16_t rawLinAccelX, rawLinAccelY, rawLinAccelZ, accelLinAccuracy;
@@ -0,0 +1,167 @@
+#include "VCNL4040.h"
+#include "../LokaBus.h"
+
+#define VCNL4040_ALS_SD      0x0001  //ALS_CONF: ALS shut down
+#define VCNL4040_PS_SD       0x0001  //PS_CONF1: PS shut down
+#define VCNL4040_PS_HD       0x0800  //PS_CONF2: 16-bit output
+#define VCNL4040_WHITE_SD    0x8000  //PS_MS: white channel shut down
+#define VCNL4040_PS_MS       0x4000  //PS_MS: INT is a plain near/far logic output
+#define VCNL4040_ALS_INT_EN  0x0002  //ALS_CONF: threshold interrupt
+
+bool VCNL4040::begin(TwoWire &wirePort, uint8_t channels) {
+  _i2cPort = &wirePort;
+  if (!isConnected()) {
+    return false;
+  }
+  _channels = channels & VCNL4040_CH_ALL;
+  return _applyChannels();
+}
+
+bool VCNL4040::isConnected() {
+  uint16_t id;
+  if (!readRegister(VCNL4040_ID, id)) {
+    return false;
+  }
+  return id == VCNL4040_DEVICE_ID;
+}
+
+bool VCNL4040::setChannels(uint8_t channels) {
+  _channels = channels & VCNL4040_CH_ALL;
+  return _applyChannels();
+}
+
+//Writes all three configuration registers with the shut-down bits set from _channels
+bool VCNL4040::_applyChannels() {
+  if (_channels & VCNL4040_CH_AMBIENT) _alsConf &= ~VCNL4040_ALS_SD;
+  else _alsConf |= VCNL4040_ALS_SD;
+
+  if (_channels & VCNL4040_CH_PROX) _psConf12 &= ~VCNL4040_PS_SD;
+  else _psConf12 |= VCNL4040_PS_SD;
+
+  if (_channels & VCNL4040_CH_WHITE) _psConf3Ms &= ~VCNL4040_WHITE_SD;
+  else _psConf3Ms |= VCNL4040_WHITE_SD;
+
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  return _writeLocked(VCNL4040_ALS_CONF, _alsConf) &&
+         _writeLocked(VCNL4040_PS_CONF1_2, _psConf12) &&
+         _writeLocked(VCNL4040_PS_CONF3_MS, _psConf3Ms);
+}
+
+bool VCNL4040::setAmbientIntegrationTime(VCNL4040_AlsIt it) {
+  _alsConf = (_alsConf & ~0x00C0) | ((uint16_t)(it & 0x03) << 6);
+  return writeRegister(VCNL4040_ALS_CONF, _alsConf);
+}
+
+bool VCNL4040::setProxIntegrationTime(VCNL4040_PsIt it) {
+  _psConf12 = (_psConf12 & ~0x000E) | ((uint16_t)(it & 0x07) << 1);
+  return writeRegister(VCNL4040_PS_CONF1_2, _psConf12);
+}
+
+bool VCNL4040::setProxDutyCycle(VCNL4040_PsDuty duty) {
+  _psConf12 = (_psConf12 & ~0x00C0) | ((uint16_t)(duty & 0x03) << 6);
+  return writeRegister(VCNL4040_PS_CONF1_2, _psConf12);
+}
+
+bool VCNL4040::setLedCurrent(VCNL4040_LedCurrent current) {
+  _psConf3Ms = (_psConf3Ms & ~0x0700) | ((uint16_t)(current & 0x07) << 8);
+  return writeRegister(VCNL4040_PS_CONF3_MS, _psConf3Ms);
+}
+
+bool VCNL4040::setProxHighResolution(bool enable) {
+  if (enable) _psConf12 |= VCNL4040_PS_HD;
+  else _psConf12 &= ~VCNL4040_PS_HD;
+  return writeRegister(VCNL4040_PS_CONF1_2, _psConf12);
+}
+
+bool VCNL4040::setProxThresholds(uint16_t low, uint16_t high) {
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  return _writeLocked(VCNL4040_PS_THDL, low) && _writeLocked(VCNL4040_PS_THDH, high);
+}
+
+bool VCNL4040::setAmbientThresholds(uint16_t low, uint16_t high) {
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  return _writeLocked(VCNL4040_ALS_THDL, low) && _writeLocked(VCNL4040_ALS_THDH, high);
+}
+
+//Also leaves logic output mode: the flags in INT_FLAG are what tells close from away
+bool VCNL4040::setProxInterrupt(VCNL4040_PsInt mode) {
+  _psConf12 = (_psConf12 & ~0x0300) | ((uint16_t)(mode & 0x03) << 8);
+  _psConf3Ms &= ~VCNL4040_PS_MS;
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  return _writeLocked(VCNL4040_PS_CONF3_MS, _psConf3Ms) && _writeLocked(VCNL4040_PS_CONF1_2, _psConf12);
+}
+
+bool VCNL4040::setAmbientInterrupt(bool enable) {
+  if (enable) _alsConf |= VCNL4040_ALS_INT_EN;
+  else _alsConf &= ~VCNL4040_ALS_INT_EN;
+  return writeRegister(VCNL4040_ALS_CONF, _alsConf);
+}
+
+//Persistence register field n selects 1, 2, 3, 4 (PS) or 1, 2, 4, 8 (ALS) readings
+bool VCNL4040::setPersistence(uint8_t proxCount, uint8_t ambientCount) {
+  const uint8_t ps = proxCount >= 4 ? 3 : (proxCount ? proxCount - 1 : 0);
+  const uint8_t als = ambientCount >= 8 ? 3 : (ambientCount >= 4 ? 2 : (ambientCount >= 2 ? 1 : 0));
+  _psConf12 = (_psConf12 & ~0x0030) | ((uint16_t)ps << 4);
+  _alsConf = (_alsConf & ~0x000C) | ((uint16_t)als << 2);
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  return _writeLocked(VCNL4040_PS_CONF1_2, _psConf12) && _writeLocked(VCNL4040_ALS_CONF, _alsConf);
+}
+
+bool VCNL4040::readInterruptFlags(uint8_t &flags) {
+  uint16_t value;
+  if (!readRegister(VCNL4040_INT_FLAG, value)) {
+    return false;
+  }
+  flags = (uint8_t)(value >> 8);
+  return true;
+}
+
+//The part has no register auto-increment, so each channel is its own
+//write/repeated-start/read; disabled channels are skipped entirely
+bool VCNL4040::read() {
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  bool ok = true;
+  if (_channels & VCNL4040_CH_PROX) ok &= _readLocked(VCNL4040_PROX, _prox);
+  if (_channels & VCNL4040_CH_AMBIENT) ok &= _readLocked(VCNL4040_AMBIENT, _ambient);
+  if (_channels & VCNL4040_CH_WHITE) ok &= _readLocked(VCNL4040_WHITE, _white);
+  return ok;
+}
+
+//0.1 lux per count at 80 ms, halving with each doubling of the integration time
+float VCNL4040::getLux() {
+  const uint8_t it = (_alsConf >> 6) & 0x03;
+  return _ambient * (0.1f / (float)(1 << it));
+}
+
+bool VCNL4040::readRegister(uint8_t reg, uint16_t &value) {
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  return _readLocked(reg, value);
+}
+
+bool VCNL4040::writeRegister(uint8_t reg, uint16_t value) {
+  LokaBusLock lock(LokaI2C, BUS_LIGHT);
+  return _writeLocked(reg, value);
+}
+
+bool VCNL4040::_readLocked(uint8_t reg, uint16_t &value) {
+  _i2cPort->beginTransmission(VCNL4040_I2C_ADDR);
+  _i2cPort->write(reg);
+  if (_i2cPort->endTransmission(false) != 0) {
+    return false;
+  }
+  if (_i2cPort->requestFrom((uint8_t)VCNL4040_I2C_ADDR, (uint8_t)2) != 2) {
+    return false;
+  }
+  uint8_t lsb = _i2cPort->read();
+  uint8_t msb = _i2cPort->read();
+  value = (uint16_t)lsb | ((uint16_t)msb << 8);
+  return true;
+}
+
+bool VCNL4040::_writeLocked(uint8_t reg, uint16_t value) {
+  _i2cPort->beginTransmission(VCNL4040_I2C_ADDR);
+  _i2cPort->write(reg);
+  _i2cPort->write((uint8_t)(value & 0xFF));
+  _i2cPort->write((uint8_t)(value >> 8));
+  return _i2cPort->endTransmission() == 0;
+}
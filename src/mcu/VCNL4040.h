@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Arduino.h"
+#include <Wire.h>
+
+#define VCNL4040_I2C_ADDR    0x60
+
+//Command codes, each one a 16-bit little endian register
+#define VCNL4040_ALS_CONF    0x00
+#define VCNL4040_ALS_THDH    0x01
+#define VCNL4040_ALS_THDL    0x02
+#define VCNL4040_PS_CONF1_2  0x03
+#define VCNL4040_PS_CONF3_MS 0x04
+#define VCNL4040_PS_CANC     0x05
+#define VCNL4040_PS_THDL     0x06
+#define VCNL4040_PS_THDH     0x07
+#define VCNL4040_PROX        0x08
+#define VCNL4040_AMBIENT     0x09
+#define VCNL4040_WHITE       0x0A
+#define VCNL4040_INT_FLAG    0x0B
+#define VCNL4040_ID          0x0C
+
+#define VCNL4040_DEVICE_ID   0x0186
+
+//Channels read by read()
+#define VCNL4040_CH_PROX     0x01
+#define VCNL4040_CH_AMBIENT  0x02
+#define VCNL4040_CH_WHITE    0x04
+#define VCNL4040_CH_ALL      0x07
+
+//INT_FLAG bits (high byte of 0x0B); reading the register clears them and releases INT
+#define VCNL4040_INT_PS_AWAY   0x01
+#define VCNL4040_INT_PS_CLOSE  0x02
+#define VCNL4040_INT_ALS_HIGH  0x10
+#define VCNL4040_INT_ALS_LOW   0x20
+
+//Which proximity crossings assert INT
+enum VCNL4040_PsInt : uint8_t {
+	VCNL4040_PS_INT_OFF = 0,
+	VCNL4040_PS_INT_CLOSE = 1,
+	VCNL4040_PS_INT_AWAY = 2,
+	VCNL4040_PS_INT_BOTH = 3
+};
+
+//ALS integration time; longer is more sensitive and slower
+enum VCNL4040_AlsIt : uint8_t {
+	VCNL4040_ALS_IT_80MS = 0,
+	VCNL4040_ALS_IT_160MS = 1,
+	VCNL4040_ALS_IT_320MS = 2,
+	VCNL4040_ALS_IT_640MS = 3
+};
+
+//PS integration time in units of T (about 125 us at 1T)
+enum VCNL4040_PsIt : uint8_t {
+	VCNL4040_PS_IT_1T = 0,
+	VCNL4040_PS_IT_1_5T = 1,
+	VCNL4040_PS_IT_2T = 2,
+	VCNL4040_PS_IT_2_5T = 3,
+	VCNL4040_PS_IT_3T = 4,
+	VCNL4040_PS_IT_3_5T = 5,
+	VCNL4040_PS_IT_4T = 6,
+	VCNL4040_PS_IT_8T = 7
+};
+
+//IR LED on-time ratio; 1/40 gives the fastest proximity updates
+enum VCNL4040_PsDuty : uint8_t {
+	VCNL4040_PS_DUTY_40 = 0,
+	VCNL4040_PS_DUTY_80 = 1,
+	VCNL4040_PS_DUTY_160 = 2,
+	VCNL4040_PS_DUTY_320 = 3
+};
+
+enum VCNL4040_LedCurrent : uint8_t {
+	VCNL4040_LED_50MA = 0,
+	VCNL4040_LED_75MA = 1,
+	VCNL4040_LED_100MA = 2,
+	VCNL4040_LED_120MA = 3,
+	VCNL4040_LED_140MA = 4,
+	VCNL4040_LED_160MA = 5,
+	VCNL4040_LED_180MA = 6,
+	VCNL4040_LED_200MA = 7
+};
+
+class VCNL4040
+{
+public:
+	bool begin(TwoWire &wirePort = Wire, uint8_t channels = VCNL4040_CH_ALL);
+	bool isConnected(); //Checks the ID register
+
+	//Unused blocks are shut down in the part, so they cost neither bus time nor power
+	bool setChannels(uint8_t channels);
+	uint8_t getChannels() { return _channels; }
+
+	bool setAmbientIntegrationTime(VCNL4040_AlsIt it);
+	bool setProxIntegrationTime(VCNL4040_PsIt it);
+	bool setProxDutyCycle(VCNL4040_PsDuty duty);
+	bool setLedCurrent(VCNL4040_LedCurrent current);
+	bool setProxHighResolution(bool enable); //16-bit instead of 12-bit proximity
+
+	//Threshold interrupts. Proximity: close above high, away below low, the part tracks which
+	//side it is on. Ambient: INT whenever the reading leaves the low..high window.
+	bool setProxThresholds(uint16_t low, uint16_t high);
+	bool setAmbientThresholds(uint16_t low, uint16_t high);
+	bool setProxInterrupt(VCNL4040_PsInt mode);
+	bool setAmbientInterrupt(bool enable);
+	bool setPersistence(uint8_t proxCount, uint8_t ambientCount); //Readings before INT: PS 1..4, ALS 1, 2, 4, 8
+	bool readInterruptFlags(uint8_t &flags); //VCNL4040_INT_* bits, clears them
+
+	//Reads every enabled channel under one bus lock, one transaction per channel
+	bool read();
+	uint16_t getProximity() { return _prox; }
+	uint16_t getAmbient() { return _ambient; }
+	uint16_t getWhite() { return _white; }
+	float getLux(); //Ambient count scaled by the integration time
+
+	bool readRegister(uint8_t reg, uint16_t &value);
+	bool writeRegister(uint8_t reg, uint16_t value);
+
+private:
+	TwoWire *_i2cPort = NULL;
+	uint8_t _channels = 0;
+
+	//Shadows of the configuration registers, so a setting is one write and no read
+	uint16_t _alsConf = 0x0000;   //80 ms, interrupt off, on
+	uint16_t _psConf12 = 0x080E;  //1/40 duty, 8T, 16-bit output, on
+	uint16_t _psConf3Ms = 0x4710; //smart persistence, 200 mA LED, white on
+
+	uint16_t _prox = 0, _ambient = 0, _white = 0;
+
+	bool _readLocked(uint8_t reg, uint16_t &value);
+	bool _writeLocked(uint8_t reg, uint16_t value);
+	bool _applyChannels();
+};
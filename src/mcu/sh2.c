@@ -521,20 +521,29 @@ static uint8_t getReportLen(sh2_t *pSh2, uint8_t reportId)
 }
 
 // Produce 64-bit microsecond timestamp for a sensor event
-static uint64_t touSTimestamp(uint32_t hostInt, int32_t referenceDelta, uint16_t delay)
+static uint64_t touSTimestamp(sh2_t *pSh2, uint32_t hostInt, int32_t referenceDelta, uint16_t delay)
 {
     static uint32_t lastHostInt = 0;
     static uint32_t rollovers = 0;
     uint64_t timestamp;
 
-    // Count times hostInt timestamps rolLED over to produce upper bits
-    if (hostInt < lastHostInt) {
-        rollovers++;
+    if (pSh2->pHal->getTimeUs64 != 0) {
+        // hostInt is in the past: step back from the HAL's own 64-bit time
+        uint64_t now = pSh2->pHal->getTimeUs64(pSh2->pHal);
+        timestamp = now - (uint32_t)((uint32_t)now - hostInt);
     }
-    lastHostInt = hostInt;
-    
-    timestamp = ((uint64_t)rollovers << 32);
-    timestamp += hostInt + (referenceDelta + delay) * 100;
+    else {
+        // Count times hostInt timestamps rolLED over to produce upper bits
+        if (hostInt < lastHostInt) {
+            rollovers++;
+        }
+        lastHostInt = hostInt;
+
+        timestamp = ((uint64_t)rollovers << 32) + hostInt;
+    }
+
+    // Apply the (usually negative) report delay in 64 bits so it can't wrap
+    timestamp = (uint64_t)((int64_t)timestamp + ((int64_t)referenceDelta + delay) * 100);
 
     return timestamp;
 }
@@ -578,7 +587,7 @@ static void sensorhubInputHdlr(sh2_t *pSh2, uint8_t *payload, uint16_t len, uint
             else {
                 uint8_t *pReport = payload+cursor;
                 uint16_t delay = ((pReport[2] & 0xFC) << 6) + pReport[3];
-                event.timestamp_uS = touSTimestamp(timestamp, referenceDelta, delay);
+                event.timestamp_uS = touSTimestamp(pSh2, timestamp, referenceDelta, delay);
                 event.reportId = reportId;
                 memcpy(event.report, pReport, reportLen);
                 event.len = reportLen;
@@ -615,7 +624,7 @@ static void sensorhubInputGyroRvHdlr(void *cookie, uint8_t *payload, uint16_t le
     uint8_t reportLen = getReportLen(pSh2, reportId);
 
     while (cursor < len) {
-        event.timestamp_uS = timestamp;
+        event.timestamp_uS = touSTimestamp(pSh2, timestamp, 0, 0);
         event.reportId = reportId;
         memcpy(event.report, payload+cursor, reportLen);
         event.len = reportLen;
@@ -100,6 +100,12 @@ struct sh2_Hal_s {
     // microsecond counter.  The count may roll over after 2^32
     // microseconds.  
     uint32_t (*getTimeUs)(sh2_Hal_t *self);
+
+    // Optional, may be 0.  The same microsecond counter extended to
+    // 64 bits.  When set, event timestamps are extended from it
+    // instead of counting rollovers separately, so both agree on the
+    // upper bits.
+    uint64_t (*getTimeUs64)(sh2_Hal_t *self);
 };
 
 // End of include guard
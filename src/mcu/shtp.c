@@ -617,6 +617,19 @@ static void rxAssemble(shtp_t *pShtp, uint8_t *in, uint16_t len, uint32_t t_us)
         // Only use the valid portion of the transfer
         len = payloadLen;
     }
+
+    // A payload that arrived in one transfer (the usual case) is delivered in place,
+    // without copying it into inPayload first.
+    if ((pShtp->inRemaining == 0) && (len == payloadLen)) {
+        if (pShtp->chan[chan].callback != 0) {
+            pShtp->chan[chan].callback(pShtp->chan[chan].cookie,
+                                       in+SHTP_HDR_LEN, len-SHTP_HDR_LEN,
+                                       t_us);
+        }
+        pShtp->chan[chan].nextInSeq = seq + 1;
+        return;
+    }
+
     memcpy(pShtp->inPayload + pShtp->inCursor, in+SHTP_HDR_LEN, len-SHTP_HDR_LEN);
     pShtp->inCursor += len-SHTP_HDR_LEN;
     pShtp->inRemaining = payloadLen - len;
@@ -21,6 +21,7 @@
 
 #include "SparkFun_VL53L5CX_IO.h"
 #include "SparkFun_VL53L5CX_Library_Constants.h"
+#include "../LokaBus.h"
 
 bool SparkFun_VL53L5CX_IO::begin(byte address, TwoWire &wirePort)
 {
@@ -31,6 +32,7 @@ bool SparkFun_VL53L5CX_IO::begin(byte address, TwoWire &wirePort)
 
 bool SparkFun_VL53L5CX_IO::isConnected()
 {
+    LokaBusLock lock(LokaI2C, BUS_TOF);
     _i2cPort->beginTransmission(_address);
     if (_i2cPort->endTransmission() != 0)
         return (false);
@@ -49,34 +51,44 @@ uint8_t SparkFun_VL53L5CX_IO::writeMultipleBytes(uint16_t registerAddress, uint8
     uint8_t i2cError = 0;
     uint32_t startSpot = 0;
     uint32_t bytesToSend = bufferSize;
+    uint32_t startMicros = micros();
+    LokaBusLock lock(LokaI2C, BUS_TOF);
     while (bytesToSend > 0)
     {
         uint32_t len = bytesToSend;
-        if (len > (wireMaxPacketSize - 2)) // Allow 2 byte for register address
+        if (len > (uint32_t)(wireMaxPacketSize - 2)) // Allow 2 byte for register address
             len = (wireMaxPacketSize - 2);
 
         _i2cPort->beginTransmission((uint8_t)_address);
         _i2cPort->write(highByte(registerAddress));
         _i2cPort->write(lowByte(registerAddress));
-
-        // TODO write a subsection of the buffer rather than byte wise
-        for (uint16_t x = 0; x < len; x++)
-            _i2cPort->write(buffer[startSpot + x]); // Write a portion of the payload to the bus
+        _i2cPort->write(&buffer[startSpot], len); // Hand the whole slice to the Wire buffer in one call
 
         i2cError = _i2cPort->endTransmission(); // Release bus because we are writing the address each time
         if (i2cError != 0)
-            return (i2cError); // Sensor did not ACK
+            break; // Sensor did not ACK
 
         startSpot += len; // Move the pointer forward
         bytesToSend -= len;
         registerAddress += len; // Move register address forward
+        if (bytesToSend > 0)
+            LokaI2C.Yield(BUS_TOF); // Each slice carries its own address, let the IMU in between
     }
+    bytesWritten += startSpot;
+    writeMicros += micros() - startMicros;
     return (i2cError);
 }
 
+void SparkFun_VL53L5CX_IO::resetTransferStats()
+{
+    bytesWritten = 0;
+    writeMicros = 0;
+}
+
 uint8_t SparkFun_VL53L5CX_IO::readMultipleBytes(uint16_t registerAddress, uint8_t *buffer, uint16_t bufferSize)
 {
     uint8_t i2cError = 0;
+    LokaBusLock lock(LokaI2C, BUS_TOF);
 
     // Write address to read from
     _i2cPort->beginTransmission(_address);
@@ -107,6 +119,8 @@ uint8_t SparkFun_VL53L5CX_IO::readMultipleBytes(uint16_t registerAddress, uint8_
 
         offset += bytesToRead;
         bytesToReadRemaining -= bytesToRead;
+        if (bytesToReadRemaining > 0)
+            LokaI2C.Yield(BUS_TOF); // The sensor keeps its read index across other transfers
     }
 
     return (0); // Success
@@ -114,6 +128,7 @@ uint8_t SparkFun_VL53L5CX_IO::readMultipleBytes(uint16_t registerAddress, uint8_
 
 uint8_t SparkFun_VL53L5CX_IO::readSingleByte(uint16_t registerAddress)
 {
+    LokaBusLock lock(LokaI2C, BUS_TOF);
     _i2cPort->beginTransmission(_address);
     _i2cPort->write(highByte(registerAddress));
     _i2cPort->write(lowByte(registerAddress));
@@ -124,6 +139,7 @@ uint8_t SparkFun_VL53L5CX_IO::readSingleByte(uint16_t registerAddress)
 
 uint8_t SparkFun_VL53L5CX_IO::writeSingleByte(uint16_t registerAddress, uint8_t const value)
 {
+    LokaBusLock lock(LokaI2C, BUS_TOF);
     _i2cPort->beginTransmission(_address);
     _i2cPort->write(highByte(registerAddress));
     _i2cPort->write(lowByte(registerAddress));
@@ -38,6 +38,10 @@ private:
   // I2C maximum packet size
   uint8_t wireMaxPacketSize = I2C_BUFFER_SIZE;
 
+  // Payload bytes and time spent in writeMultipleBytes() since the last reset
+  uint32_t bytesWritten = 0;
+  uint32_t writeMicros = 0;
+
 public:
   // Default constructor
   SparkFun_VL53L5CX_IO(){};
@@ -68,6 +72,11 @@ public:
 
   // Set I2C maximum packet size
   void setMaxPacketSize(uint8_t newSize) { wireMaxPacketSize = newSize; }
+
+  // Bulk write statistics, used to measure firmware upload throughput
+  uint32_t getBytesWritten() { return bytesWritten; }
+  uint32_t getWriteMicros() { return writeMicros; }
+  void resetTransferStats();
 };
 
 #endif
\ No newline at end of file
@@ -31,6 +31,25 @@ void SparkFun_VL53L5CX::clearErrorStruct()
 }
 
 bool SparkFun_VL53L5CX::begin(byte address, TwoWire &wirePort)
+{
+    if (!openDevice(address, wirePort))
+        return false;
+
+    VL53L5CX_i2c->resetTransferStats();
+    uint8_t result = vl53l5cx_init(Dev);
+    _uploadBytes = VL53L5CX_i2c->getBytesWritten();
+    _uploadMicros = VL53L5CX_i2c->getWriteMicros();
+
+    if (result == 0)
+        return true;
+
+    lastError.lastErrorCode = SF_VL53L5CX_ERROR_TYPE::DEVICE_INITIALIZATION_ERROR;
+    lastError.lastErrorValue = static_cast<uint32_t>(result);
+    SAFE_CALLBACK(errorCallback, lastError.lastErrorCode, lastError.lastErrorValue);
+    return false;
+}
+
+bool SparkFun_VL53L5CX::openDevice(byte address, TwoWire &wirePort)
 {
     clearErrorStruct();
 
@@ -40,7 +59,6 @@ bool SparkFun_VL53L5CX::begin(byte address, TwoWire &wirePort)
     Dev->platform.VL53L5CX_i2c = VL53L5CX_i2c;
 
     bool ready = VL53L5CX_i2c->begin(address, wirePort);
-    uint8_t result = 0;
     uint8_t deviceId = 0;
     uint8_t revisionId = 0;
 
@@ -63,15 +81,46 @@ bool SparkFun_VL53L5CX::begin(byte address, TwoWire &wirePort)
         return false;
     }
 
-    result = vl53l5cx_init(Dev);
+    return true;
+}
 
-    if (result == 0)
-        return true;
+bool SparkFun_VL53L5CX::beginAsync(byte address, TwoWire &wirePort)
+{
+    if (!openDevice(address, wirePort))
+        return false;
 
-    lastError.lastErrorCode = SF_VL53L5CX_ERROR_TYPE::DEVICE_INITIALIZATION_ERROR;
-    lastError.lastErrorValue = static_cast<uint32_t>(result);
-    SAFE_CALLBACK(errorCallback, lastError.lastErrorCode, lastError.lastErrorValue);
-    return false;
+    VL53L5CX_i2c->resetTransferStats();
+    vl53l5cx_init_start(Dev, &_initState);
+    return true;
+}
+
+bool SparkFun_VL53L5CX::initStep(uint32_t budgetMs)
+{
+    if (_initState.phase == VL53L5CX_INIT_FAILED)
+        return false;
+
+    uint8_t done = 0;
+    uint8_t result = vl53l5cx_init_step(Dev, &_initState, budgetMs, &done);
+
+    if (result != 0)
+    {
+        lastError.lastErrorCode = SF_VL53L5CX_ERROR_TYPE::DEVICE_INITIALIZATION_ERROR;
+        lastError.lastErrorValue = static_cast<uint32_t>(result);
+        SAFE_CALLBACK(errorCallback, lastError.lastErrorCode, lastError.lastErrorValue);
+        return false;
+    }
+
+    if (done)
+    {
+        _uploadBytes = VL53L5CX_i2c->getBytesWritten();
+        _uploadMicros = VL53L5CX_i2c->getWriteMicros();
+    }
+    return true;
+}
+
+bool SparkFun_VL53L5CX::isInitDone()
+{
+    return _initState.phase == VL53L5CX_INIT_DONE;
 }
 
 void SparkFun_VL53L5CX::setErrorCallback(void (*_errorCallback)(SF_VL53L5CX_ERROR_TYPE errorCode, uint32_t errorValue))
@@ -241,6 +290,28 @@ bool SparkFun_VL53L5CX::stopRanging()
     return false;
 }
 
+bool SparkFun_VL53L5CX::setOutputProfile(uint32_t outputMask)
+{
+    clearErrorStruct();
+
+    uint8_t result = vl53l5cx_set_output_enable(Dev, outputMask);
+
+    if (result == 0)
+        return true;
+
+    lastError.lastErrorCode = SF_VL53L5CX_ERROR_TYPE::INVALID_OUTPUT_PROFILE;
+    lastError.lastErrorValue = static_cast<uint32_t>(result);
+    SAFE_CALLBACK(errorCallback, lastError.lastErrorCode, lastError.lastErrorValue);
+    return false;
+}
+
+uint32_t SparkFun_VL53L5CX::getOutputProfile()
+{
+    uint32_t outputMask = 0;
+    vl53l5cx_get_output_enable(Dev, &outputMask);
+    return outputMask;
+}
+
 bool SparkFun_VL53L5CX::isDataReady()
 {
     clearErrorStruct();
@@ -305,6 +376,20 @@ bool SparkFun_VL53L5CX::getRangingData(VL53L5CX_ResultsData *pRangingData)
     return false;
 }
 
+bool SparkFun_VL53L5CX::getRangingDistance(int16_t *pDistance, const uint8_t *pZoneMap, int16_t invalidValue)
+{
+    clearErrorStruct();
+
+    uint8_t result = vl53l5cx_get_ranging_distance(Dev, pDistance, pZoneMap, invalidValue);
+    if (result == 0)
+        return true;
+
+    lastError.lastErrorCode = SF_VL53L5CX_ERROR_TYPE::CANNOT_GET_RANGING_DATA;
+    lastError.lastErrorValue = static_cast<uint32_t>(result);
+    SAFE_CALLBACK(errorCallback, lastError.lastErrorCode, lastError.lastErrorValue);
+    return false;
+}
+
 bool SparkFun_VL53L5CX::setPowerMode(SF_VL53L5CX_POWER_MODE powerMode)
 {
     clearErrorStruct();
@@ -486,4 +571,11 @@ uint8_t SparkFun_VL53L5CX::getWireMaxPacketSize()
 void SparkFun_VL53L5CX::setWireMaxPacketSize(uint8_t newSize)
 {
     VL53L5CX_i2c->setMaxPacketSize(newSize);
+}
+
+uint32_t SparkFun_VL53L5CX::getUploadRate()
+{
+    if (_uploadMicros == 0)
+        return 0;
+    return (uint32_t)(((uint64_t)_uploadBytes * 1000000ULL) / _uploadMicros);
 }
\ No newline at end of file
@@ -51,6 +51,16 @@ private:
     // Clears the error struct to a no-error state.
     void clearErrorStruct();
 
+    // Bytes written and time spent on the bus during the last vl53l5cx_init().
+    uint32_t _uploadBytes = 0;
+    uint32_t _uploadMicros = 0;
+
+    // Progress of the initialization started by beginAsync().
+    VL53L5CX_InitState _initState = {};
+
+    // Creates the driver objects and checks the device and revision IDs.
+    bool openDevice(byte address, TwoWire &wirePort);
+
 public:
     SparkFun_VL53L5CX_IO* VL53L5CX_i2c; // I2C driver object
     VL53L5CX_Configuration* Dev;        // Sensor condfiguration struct
@@ -64,6 +74,18 @@ public:
     // Start up the sensor. Passing an address and Wire port instance is optional.
     bool begin(byte address = (DEFAULT_I2C_ADDR >> 1), TwoWire &wirePort = Wire);
 
+    // Starts a non-blocking initialization. The firmware upload and the waits for the
+    // sensor are then spread over calls to initStep().
+    bool beginAsync(byte address = (DEFAULT_I2C_ADDR >> 1), TwoWire &wirePort = Wire);
+
+    // Runs the initialization for at most about budgetMs (one firmware slice or one
+    // register sequence may overrun it). Returns false if the initialization failed.
+    // If this function returns false an error entry will be stored in the lastError struct.
+    bool initStep(uint32_t budgetMs);
+
+    // Returns true once the initialization started by beginAsync() is complete.
+    bool isInitDone();
+
     // Set the error callback function.
     void setErrorCallback(void (*errorCallback)(SF_VL53L5CX_ERROR_TYPE errorCode, uint32_t errorValue));
 
@@ -100,6 +122,14 @@ public:
     // If this function returns false an error entry will be stored in the lastError struct.
     bool stopRanging();
 
+    // Returns true if the output profile (OR of VL53L5CX_OUTPUT_* bits) was accepted or false otherwise.
+    // Only the selected result blocks are sent over I2C and decoded. Takes effect at the next startRanging().
+    // If this function returns false an error entry will be stored in the lastError struct.
+    bool setOutputProfile(uint32_t outputMask);
+
+    // Returns the current output profile.
+    uint32_t getOutputProfile();
+
     // Returns true if data is ready.
     bool isDataReady();
 
@@ -115,6 +145,13 @@ public:
     // If this function returns false an error entry will be stored in the lastError struct.
     bool getRangingData(VL53L5CX_ResultsData *pRangingData);
 
+    // Returns true if the distances were read from the sensor or false otherwise.
+    // Only the first target of each zone is decoded, straight into pDistance (16 or 64 entries).
+    // pZoneMap optionally gives the index in pDistance of each sensor zone.
+    // Zones without a positive distance are set to invalidValue.
+    // If this function returns false an error entry will be stored in the lastError struct.
+    bool getRangingDistance(int16_t *pDistance, const uint8_t *pZoneMap = nullptr, int16_t invalidValue = 0);
+
     // Returns true if the sensor's power mode was changed accordingly or false otherwise.
     // If this function returns false an error entry will be stored in the lastError struct.
     bool setPowerMode(SF_VL53L5CX_POWER_MODE powerMode);
@@ -152,5 +189,14 @@ public:
 
     // Sets I2C maximum packet size.
     void setWireMaxPacketSize(uint8_t newSize = I2C_BUFFER_SIZE);
+
+    // Returns the number of bytes written during begin() (firmware, offsets, xtalk and configuration).
+    uint32_t getUploadBytes() { return _uploadBytes; }
+
+    // Returns the time in microseconds spent on bulk writes during begin().
+    uint32_t getUploadMicros() { return _uploadMicros; }
+
+    // Returns the measured bulk write throughput of begin() in bytes per second, or 0 if unknown.
+    uint32_t getUploadRate();
 };
 #endif
\ No newline at end of file
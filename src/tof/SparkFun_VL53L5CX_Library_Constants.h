@@ -2,6 +2,7 @@
 #define __SparkFun_VL53L5CX_Library_Constants__
 
 #include <stdint.h>
+#include <Wire.h>
 
 // Macro for invoking the callback if the function pointer is valid
 #define SAFE_CALLBACK(cb, code, value) \
@@ -13,7 +14,12 @@
 // Constants declarations
 
 const uint8_t DEFAULT_I2C_ADDR = 0x52;
+// Use the platform's real Wire buffer when it is known (ESP32: 128 bytes), 32 otherwise
+#if defined(I2C_BUFFER_LENGTH) && (I2C_BUFFER_LENGTH <= 255)
+const uint8_t I2C_BUFFER_SIZE = I2C_BUFFER_LENGTH;
+#else
 const uint8_t I2C_BUFFER_SIZE = 32;
+#endif
 const uint8_t REVISION_ID = 0x02;
 const uint8_t DEVICE_ID = 0xf0;
 const uint32_t UNKNOWN_ERROR_VALUE = 0xffffffff;
@@ -47,6 +53,7 @@ enum class SF_VL53L5CX_ERROR_TYPE : uint8_t
     CANNOT_SET_TARGET_ORDER,
     CANNOT_GET_TARGET_ORDER,
     INVALID_TARGET_ORDER,
+    INVALID_OUTPUT_PROFILE,
     UNKNOWN_ERROR
 };
 
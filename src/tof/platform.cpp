@@ -90,10 +90,15 @@ void SwapBuffer(uint8_t *buffer, uint16_t size)
 {
 	uint32_t i, tmp;
 
-	/* Example of possible implementation using <string.h> */
+	/* One native byte swap per word on little-endian targets (ESP32) */
 	for (i = 0; i < size; i = i + 4)
 	{
-		tmp = (buffer[i] << 24) | (buffer[i + 1] << 16) | (buffer[i + 2] << 8) | (buffer[i + 3]);
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+		memcpy(&tmp, &(buffer[i]), 4);
+		tmp = __builtin_bswap32(tmp);
+#else
+		tmp = ((uint32_t)buffer[i] << 24) | ((uint32_t)buffer[i + 1] << 16) | ((uint32_t)buffer[i + 2] << 8) | (buffer[i + 3]);
+#endif
 		memcpy(&(buffer[i]), &tmp, 4);
 	}
 }
@@ -103,3 +108,8 @@ uint8_t WaitMs(VL53L5CX_Platform *p_platform, uint32_t TimeMs)
 	delay(TimeMs);
 	return 0;
 }
+
+uint32_t GetTickMs(VL53L5CX_Platform *p_platform)
+{
+	return millis();
+}
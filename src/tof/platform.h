@@ -95,6 +95,16 @@ typedef struct
 
 #define 	VL53L5CX_NB_TARGET_PER_ZONE		1U
 
+/*
+ * @brief The macro below selects the compressed firmware image
+ * (vl53l5cx_buffers_lz.h, generated by tools/vl53l5cx_lz.py). The image is
+ * decoded during vl53l5cx_init() straight into the I2C writes, through a 4 KB
+ * window allocated for the duration of the download. Comment it out to upload
+ * the raw VL53L5CX_FIRMWARE array instead.
+ */
+
+#define 	VL53L5CX_COMPRESSED_FIRMWARE
+
 /*
  * @brief The macro below can be used to avoid data conversion into the driver.
  * By default there is a conversion between firmware and user data. Using this macro
@@ -104,6 +114,16 @@ typedef struct
 
  // #define 	VL53L5CX_USE_RAW_FORMAT
 
+/*
+ * @brief The macro below makes vl53l5cx_get_ranging_data() use the original ST
+ * result decoder, which swaps the whole frame, copies each block and then
+ * scales every zone in separate passes. By default the driver swaps, copies and
+ * scales each block in a single pass. Both decoders are always built, see
+ * vl53l5cx_decode_results(), and give the same results.
+ */
+
+ // #define 	VL53L5CX_REFERENCE_DECODE
+
 /*
  * @brief All macro below are used to configure the sensor output. User can
  * define some macros if he wants to disable selected output, in order to reduce
@@ -202,4 +222,15 @@ uint8_t WaitMs(
 		VL53L5CX_Platform *p_platform,
 		uint32_t TimeMs);
 
+/**
+ * @brief Function used by the non-blocking initialization to measure time
+ * budgets and timeouts without waiting.
+ * @param (VL53L5CX_Platform*) p_platform : Pointer of VL53L5CX platform
+ * structure.
+ * @return (uint32_t) time : Free running millisecond counter.
+ */
+
+uint32_t GetTickMs(
+		VL53L5CX_Platform *p_platform);
+
 #endif	// _PLATFORM_H_
@@ -63,6 +63,11 @@
 #include <string.h>
 #include "vl53l5cx_api.h"
 #include "vl53l5cx_buffers.h"
+#ifdef VL53L5CX_COMPRESSED_FIRMWARE
+#include "vl53l5cx_buffers_lz.h"
+#else
+#define VL53L5CX_FIRMWARE_SIZE ((uint32_t)sizeof(VL53L5CX_FIRMWARE))
+#endif
 #include <Arduino.h>
 
 /**
@@ -100,12 +105,33 @@ static uint8_t _vl53l5cx_poll_for_answer(VL53L5CX_Configuration *p_dev, uint8_t
 	return status;
 }
 
+/**
+ * @brief Inner function, not available outside this file. This function is the
+ * non-blocking counterpart of _vl53l5cx_poll_for_answer(): it reads the status
+ * once and reports whether the expected answer is there.
+ */
+
+static uint8_t _vl53l5cx_check_for_answer(VL53L5CX_Configuration *p_dev, uint8_t size, uint8_t pos, uint16_t address, uint8_t mask, uint8_t expected_value, uint8_t *p_answered)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+
+	status |= RdMulti(&(p_dev->platform), address, p_dev->temp_buffer, size);
+	if ((size >= (uint8_t)4) && (p_dev->temp_buffer[2] >= (uint8_t)0x7f))
+	{
+		status |= VL53L5CX_MCU_ERROR;
+	}
+
+	*p_answered = ((p_dev->temp_buffer[pos] & mask) == expected_value) ? (uint8_t)1 : (uint8_t)0;
+
+	return status;
+}
+
 /**
  * @brief Inner function, not available outside this file. This function is used
- * to set the offset data gathered from NVM.
+ * to write the offset data gathered from NVM, without waiting for the answer.
  */
 
-static uint8_t _vl53l5cx_send_offset_data(VL53L5CX_Configuration *p_dev, uint8_t resolution)
+static uint8_t _vl53l5cx_write_offset_data(VL53L5CX_Configuration *p_dev, uint8_t resolution)
 {
 	uint8_t status = VL53L5CX_STATUS_OK;
 	uint32_t signal_grid[64];
@@ -149,6 +175,20 @@ static uint8_t _vl53l5cx_send_offset_data(VL53L5CX_Configuration *p_dev, uint8_t
 
 	(void)memcpy(&(p_dev->temp_buffer[0x1E0]), footer, 8);
 	status |= WrMulti(&(p_dev->platform), 0x2e18, p_dev->temp_buffer, VL53L5CX_OFFSET_BUFFER_SIZE);
+
+	return status;
+}
+
+/**
+ * @brief Inner function, not available outside this file. This function is used
+ * to set the offset data gathered from NVM.
+ */
+
+static uint8_t _vl53l5cx_send_offset_data(VL53L5CX_Configuration *p_dev, uint8_t resolution)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+
+	status |= _vl53l5cx_write_offset_data(p_dev, resolution);
 	status |= _vl53l5cx_poll_for_answer(p_dev, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03);
 
 	return status;
@@ -156,10 +196,11 @@ static uint8_t _vl53l5cx_send_offset_data(VL53L5CX_Configuration *p_dev, uint8_t
 
 /**
  * @brief Inner function, not available outside this file. This function is used
- * to set the Xtalk data from generic configuration, or user's calibration.
+ * to write the Xtalk data from generic configuration, or user's calibration,
+ * without waiting for the answer.
  */
 
-static uint8_t _vl53l5cx_send_xtalk_data(VL53L5CX_Configuration *p_dev, uint8_t resolution)
+static uint8_t _vl53l5cx_write_xtalk_data(VL53L5CX_Configuration *p_dev, uint8_t resolution)
 {
 	uint8_t status = VL53L5CX_STATUS_OK;
 	uint8_t res4x4[] = {0x0F, 0x04, 0x04, 0x17, 0x08, 0x10, 0x10, 0x07};
@@ -195,11 +236,149 @@ static uint8_t _vl53l5cx_send_xtalk_data(VL53L5CX_Configuration *p_dev, uint8_t
 	}
 
 	status |= WrMulti(&(p_dev->platform), 0x2cf8, p_dev->temp_buffer, VL53L5CX_XTALK_BUFFER_SIZE);
+
+	return status;
+}
+
+/**
+ * @brief Inner function, not available outside this file. This function is used
+ * to set the Xtalk data from generic configuration, or user's calibration.
+ */
+
+static uint8_t _vl53l5cx_send_xtalk_data(VL53L5CX_Configuration *p_dev, uint8_t resolution)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+
+	status |= _vl53l5cx_write_xtalk_data(p_dev, resolution);
 	status |= _vl53l5cx_poll_for_answer(p_dev, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03);
 
 	return status;
 }
 
+/**
+ * @brief Inner function, not available outside this file. This function is used
+ * to send DCI data to the firmware without waiting for the answer. The data
+ * buffer is swapped back before returning.
+ */
+
+static uint8_t _vl53l5cx_dci_send_data(VL53L5CX_Configuration *p_dev, uint8_t *data, uint32_t index, uint16_t data_size)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+	int16_t i;
+
+	uint8_t headers[] = {0x00, 0x00, 0x00, 0x00};
+	uint8_t footer[] = {0x00, 0x00, 0x00, 0x0f, 0x05, 0x01,
+						(uint8_t)((data_size + (uint16_t)8) >> 8),
+						(uint8_t)((data_size + (uint16_t)8) & (uint8_t)0xFF)};
+
+	uint16_t address = (uint16_t)VL53L5CX_UI_CMD_END -
+					   (data_size + (uint16_t)12) + (uint16_t)1;
+
+	/* Check if cmd buffer is large enough */
+	if ((data_size + (uint16_t)12) > (uint16_t)VL53L5CX_TEMPORARY_BUFFER_SIZE)
+	{
+		status |= VL53L5CX_STATUS_ERROR;
+	}
+	else
+	{
+		headers[0] = (uint8_t)(index >> 8);
+		headers[1] = (uint8_t)(index & (uint32_t)0xff);
+		headers[2] = (uint8_t)(((data_size & (uint16_t)0xff0) >> 4));
+		headers[3] = (uint8_t)((data_size & (uint16_t)0xf) << 4);
+
+		/* Copy data from structure to FW format (+4 bytes to add header) */
+		SwapBuffer(data, data_size);
+		for (i = (int16_t)data_size - (int16_t)1; i >= 0; i--)
+		{
+			p_dev->temp_buffer[i + 4] = data[i];
+		}
+
+		/* Add headers and footer */
+		(void)memcpy(&p_dev->temp_buffer[0], headers, sizeof(headers));
+		(void)memcpy(&p_dev->temp_buffer[data_size + (uint16_t)4],
+					 footer, sizeof(footer));
+
+		/* Send data to FW */
+		status |= WrMulti(&(p_dev->platform), address, p_dev->temp_buffer, (uint32_t)((uint32_t)data_size + (uint32_t)12));
+
+		/* Only after the write: data may be temp_buffer itself */
+		SwapBuffer(data, data_size);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Inner function, not available outside this file. This function is used
+ * to download the next slice of the firmware into the VL53L5CX, 0x8000 bytes
+ * per page starting at page 0x09. The compressed image is decoded into the ring
+ * window and each slice is written as soon as it is available.
+ */
+
+static uint8_t _vl53l5cx_download_fw_slice(VL53L5CX_Configuration *p_dev, VL53L5CX_InitState *p_init)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+	uint8_t *p_slice;
+	uint32_t pos = p_init->fw_pos, size;
+
+	if ((pos & (uint32_t)0x7FFF) == (uint32_t)0)
+	{
+		status |= WrByte(&(p_dev->platform), 0x7fff, (uint8_t)(0x09 + (pos >> 15)));
+	}
+
+	/* Stay inside the current page and the remaining image */
+	size = (uint32_t)0x8000 - (pos & (uint32_t)0x7FFF);
+	if (size > (VL53L5CX_FIRMWARE_SIZE - pos))
+	{
+		size = VL53L5CX_FIRMWARE_SIZE - pos;
+	}
+	if (size > VL53L5CX_INIT_SLICE_SIZE)
+	{
+		size = VL53L5CX_INIT_SLICE_SIZE;
+	}
+
+#ifdef VL53L5CX_COMPRESSED_FIRMWARE
+	size = vl53l5cx_lz_read(&(p_init->lz), (uint16_t)size, &p_slice);
+	if (size == (uint32_t)0)
+	{
+		/* Truncated image, never stall the state machine */
+		return VL53L5CX_STATUS_ERROR;
+	}
+#else
+	p_slice = (uint8_t *)&VL53L5CX_FIRMWARE[pos];
+#endif
+	status |= WrMulti(&(p_dev->platform), (uint16_t)(pos & (uint32_t)0x7FFF), p_slice, size);
+	p_init->fw_pos = pos + size;
+
+	return status;
+}
+
+/**
+ * @brief Inner function, not available outside this file. Helpers used by
+ * vl53l5cx_init_step() to park the state machine on a delay or on a firmware
+ * answer, then resume with the next phase.
+ */
+
+static void _vl53l5cx_init_wait(VL53L5CX_Configuration *p_dev, VL53L5CX_InitState *p_init, uint32_t wait_ms, uint8_t next_phase)
+{
+	p_init->mark_ms = GetTickMs(&(p_dev->platform));
+	p_init->wait_ms = wait_ms;
+	p_init->next_phase = next_phase;
+	p_init->phase = VL53L5CX_INIT_WAIT;
+}
+
+static void _vl53l5cx_init_poll(VL53L5CX_Configuration *p_dev, VL53L5CX_InitState *p_init, uint8_t size, uint8_t pos, uint16_t address, uint8_t mask, uint8_t expected_value, uint8_t next_phase)
+{
+	p_init->mark_ms = GetTickMs(&(p_dev->platform));
+	p_init->poll_size = size;
+	p_init->poll_pos = pos;
+	p_init->poll_address = address;
+	p_init->poll_mask = mask;
+	p_init->poll_expected = expected_value;
+	p_init->next_phase = next_phase;
+	p_init->phase = VL53L5CX_INIT_POLL;
+}
+
 uint8_t vl53l5cx_is_alive(VL53L5CX_Configuration *p_dev, uint8_t *p_is_alive)
 {
 	uint8_t status = VL53L5CX_STATUS_OK;
@@ -224,133 +403,259 @@ uint8_t vl53l5cx_is_alive(VL53L5CX_Configuration *p_dev, uint8_t *p_is_alive)
 
 uint8_t vl53l5cx_init(VL53L5CX_Configuration *p_dev)
 {
-	uint8_t tmp, status = VL53L5CX_STATUS_OK;
-	uint8_t pipe_ctrl[] = {VL53L5CX_NB_TARGET_PER_ZONE, 0x00, 0x01, 0x00};
-	uint32_t single_range = 0x01;
+	uint8_t done = 0, status = VL53L5CX_STATUS_OK;
+	VL53L5CX_InitState init;
+
+	status |= vl53l5cx_init_start(p_dev, &init);
+	while ((status == VL53L5CX_STATUS_OK) && (done == (uint8_t)0))
+	{
+		status |= vl53l5cx_init_step(p_dev, &init, (uint32_t)0xFFFFFFFFU, &done);
+		if ((status == VL53L5CX_STATUS_OK) && (done == (uint8_t)0))
+		{
+			status |= WaitMs(&(p_dev->platform), 10);
+		}
+	}
 
+	return status;
+}
+
+uint8_t vl53l5cx_init_start(VL53L5CX_Configuration *p_dev, VL53L5CX_InitState *p_init)
+{
 	p_dev->default_xtalk = (uint8_t *)VL53L5CX_DEFAULT_XTALK;
 	p_dev->default_configuration = (uint8_t *)VL53L5CX_DEFAULT_CONFIGURATION;
+	p_dev->output_enable = VL53L5CX_OUTPUT_ALL;
 
-	/* SW reboot sequence */
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x0009, 0x04);
-	status |= WrByte(&(p_dev->platform), 0x000F, 0x40);
-	status |= WrByte(&(p_dev->platform), 0x000A, 0x03);
-	status |= RdByte(&(p_dev->platform), 0x7FFF, &tmp);
-	status |= WrByte(&(p_dev->platform), 0x000C, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x0101, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x0102, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x010A, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x4002, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x4002, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x010A, 0x03);
-	status |= WrByte(&(p_dev->platform), 0x0103, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x000C, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x000F, 0x43);
-	status |= WaitMs(&(p_dev->platform), 1);
-
-	status |= WrByte(&(p_dev->platform), 0x000F, 0x40);
-	status |= WrByte(&(p_dev->platform), 0x000A, 0x01);
-	status |= WaitMs(&(p_dev->platform), 100);
-
-	/* Wait for sensor booted (several ms required to get sensor ready ) */
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
-	status |= _vl53l5cx_poll_for_answer(p_dev, 1, 0, 0x06, 0xff, 1);
+	(void)memset(p_init, 0, sizeof(VL53L5CX_InitState));
+	p_init->phase = VL53L5CX_INIT_REBOOT;
 
-	status |= WrByte(&(p_dev->platform), 0x000E, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x02);
+	return VL53L5CX_STATUS_OK;
+}
 
-	/* Enable FW access */
-	status |= WrByte(&(p_dev->platform), 0x03, 0x0D);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
-	status |= _vl53l5cx_poll_for_answer(p_dev, 1, 0, 0x21, 0x10, 0x10);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
+uint8_t vl53l5cx_init_step(VL53L5CX_Configuration *p_dev, VL53L5CX_InitState *p_init, uint32_t budget_ms, uint8_t *p_done)
+{
+	uint8_t tmp, answered, waiting = 0, status = VL53L5CX_STATUS_OK;
+	uint8_t pipe_ctrl[] = {VL53L5CX_NB_TARGET_PER_ZONE, 0x00, 0x01, 0x00};
+	uint32_t single_range = 0x01;
+	uint32_t start_ms = GetTickMs(&(p_dev->platform));
 
-	/* Enable host access to GO1 */
-	status |= WrByte(&(p_dev->platform), 0x0C, 0x01);
+	while ((status == VL53L5CX_STATUS_OK) && (waiting == (uint8_t)0)
+		   && (p_init->phase < VL53L5CX_INIT_DONE))
+	{
+		switch (p_init->phase)
+		{
+		case VL53L5CX_INIT_WAIT:
+			if ((GetTickMs(&(p_dev->platform)) - p_init->mark_ms) < p_init->wait_ms)
+			{
+				waiting = 1;
+			}
+			else
+			{
+				p_init->phase = p_init->next_phase;
+			}
+			break;
 
-	/* Power ON status */
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x101, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x102, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x010A, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x4002, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x4002, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x010A, 0x03);
-	status |= WrByte(&(p_dev->platform), 0x103, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x400F, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x21A, 0x43);
-	status |= WrByte(&(p_dev->platform), 0x21A, 0x03);
-	status |= WrByte(&(p_dev->platform), 0x21A, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x21A, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x219, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x21B, 0x00);
-
-	/* Wake up MCU */
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x000C, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
-	status |= WrByte(&(p_dev->platform), 0x0020, 0x07);
-	status |= WrByte(&(p_dev->platform), 0x0020, 0x06);
-	/* Download FW into VL53L5 */
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x09);
-	status |= WrMulti(&(p_dev->platform), 0, (uint8_t *) &VL53L5CX_FIRMWARE[0], 0x8000);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x0a);
-	status |= WrMulti(&(p_dev->platform), 0, (uint8_t *) & VL53L5CX_FIRMWARE[0x8000], 0x8000);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x0b);
-	status |= WrMulti(&(p_dev->platform), 0, (uint8_t *) & VL53L5CX_FIRMWARE[0x10000], 0x5000);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
-
-	/* Check if FW correctly downloaded */
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x02);
-	status |= WrByte(&(p_dev->platform), 0x03, 0x0D);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
-	status |= _vl53l5cx_poll_for_answer(p_dev, 1, 0, 0x21, 0x10, 0x10); //0x10
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x0C, 0x01);
+		case VL53L5CX_INIT_POLL:
+			status |= _vl53l5cx_check_for_answer(p_dev, p_init->poll_size, p_init->poll_pos,
+												 p_init->poll_address, p_init->poll_mask,
+												 p_init->poll_expected, &answered);
+			if (answered != (uint8_t)0)
+			{
+				p_init->phase = p_init->next_phase;
+			}
+			else if ((GetTickMs(&(p_dev->platform)) - p_init->mark_ms) > VL53L5CX_INIT_POLL_TIMEOUT_MS)
+			{
+				status |= VL53L5CX_STATUS_ERROR;
+			}
+			else
+			{
+				waiting = 1;
+			}
+			break;
 
-	/* Reset MCU and wait boot */
-	status |= WrByte(&(p_dev->platform), 0x7FFF, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x114, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x115, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x116, 0x42);
-	status |= WrByte(&(p_dev->platform), 0x117, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x0B, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x0C, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x0B, 0x01);
-	status |= _vl53l5cx_poll_for_answer(p_dev, 1, 0, 0x06, 0xff, 0x00);
-	status |= WrByte(&(p_dev->platform), 0x7fff, 0x02);
+		case VL53L5CX_INIT_REBOOT:
+			/* SW reboot sequence */
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x0009, 0x04);
+			status |= WrByte(&(p_dev->platform), 0x000F, 0x40);
+			status |= WrByte(&(p_dev->platform), 0x000A, 0x03);
+			status |= RdByte(&(p_dev->platform), 0x7FFF, &tmp);
+			status |= WrByte(&(p_dev->platform), 0x000C, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x0101, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x0102, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x010A, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x4002, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x4002, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x010A, 0x03);
+			status |= WrByte(&(p_dev->platform), 0x0103, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x000C, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x000F, 0x43);
+			status |= WaitMs(&(p_dev->platform), 1);
+
+			status |= WrByte(&(p_dev->platform), 0x000F, 0x40);
+			status |= WrByte(&(p_dev->platform), 0x000A, 0x01);
+			_vl53l5cx_init_wait(p_dev, p_init, 100, VL53L5CX_INIT_BOOT);
+			break;
 
-	/* Get offset NVM data and store them into the offset buffer */
-	status |= WrMulti(&(p_dev->platform), 0x2fd8, (uint8_t *)VL53L5CX_GET_NVM_CMD, sizeof(VL53L5CX_GET_NVM_CMD));
-	status |= _vl53l5cx_poll_for_answer(p_dev, 4, 0, VL53L5CX_UI_CMD_STATUS, 0xff, 2);
+		case VL53L5CX_INIT_BOOT:
+			/* Wait for sensor booted (several ms required to get sensor ready ) */
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
+			_vl53l5cx_init_poll(p_dev, p_init, 1, 0, 0x06, 0xff, 1, VL53L5CX_INIT_FW_ACCESS);
+			break;
 
-	status |= RdMulti(&(p_dev->platform), VL53L5CX_UI_CMD_START, p_dev->temp_buffer, VL53L5CX_NVM_DATA_SIZE);
+		case VL53L5CX_INIT_FW_ACCESS:
+			status |= WrByte(&(p_dev->platform), 0x000E, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x02);
 
-	(void)memcpy(p_dev->offset_data, p_dev->temp_buffer, VL53L5CX_OFFSET_BUFFER_SIZE);
+			/* Enable FW access */
+			status |= WrByte(&(p_dev->platform), 0x03, 0x0D);
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
+			_vl53l5cx_init_poll(p_dev, p_init, 1, 0, 0x21, 0x10, 0x10, VL53L5CX_INIT_POWER_ON);
+			break;
 
-	status |= _vl53l5cx_send_offset_data(p_dev, VL53L5CX_RESOLUTION_4X4);
+		case VL53L5CX_INIT_POWER_ON:
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
+
+			/* Enable host access to GO1 */
+			status |= WrByte(&(p_dev->platform), 0x0C, 0x01);
+
+			/* Power ON status */
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x101, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x102, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x010A, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x4002, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x4002, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x010A, 0x03);
+			status |= WrByte(&(p_dev->platform), 0x103, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x400F, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x21A, 0x43);
+			status |= WrByte(&(p_dev->platform), 0x21A, 0x03);
+			status |= WrByte(&(p_dev->platform), 0x21A, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x21A, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x219, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x21B, 0x00);
+
+			/* Wake up MCU */
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x000C, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
+			status |= WrByte(&(p_dev->platform), 0x0020, 0x07);
+			status |= WrByte(&(p_dev->platform), 0x0020, 0x06);
+
+			p_init->fw_pos = 0;
+#ifdef VL53L5CX_COMPRESSED_FIRMWARE
+			p_init->p_window = (uint8_t *)malloc(VL53L5CX_LZ_WINDOW_SIZE);
+			if (p_init->p_window == NULL)
+			{
+				status |= VL53L5CX_STATUS_ERROR;
+				break;
+			}
+			vl53l5cx_lz_init(&(p_init->lz), VL53L5CX_FIRMWARE_LZ, p_init->p_window);
+#endif
+			p_init->phase = VL53L5CX_INIT_FW_DOWNLOAD;
+			break;
 
-	/* Set default Xtalk shape. Send Xtalk to sensor */
-	(void)memcpy(p_dev->xtalk_data, (uint8_t *)VL53L5CX_DEFAULT_XTALK, VL53L5CX_XTALK_BUFFER_SIZE);
+		case VL53L5CX_INIT_FW_DOWNLOAD:
+			/* Download FW into VL53L5, one slice per unit of work */
+			status |= _vl53l5cx_download_fw_slice(p_dev, p_init);
+			if (p_init->fw_pos >= VL53L5CX_FIRMWARE_SIZE)
+			{
+				free(p_init->p_window);
+				p_init->p_window = NULL;
+				status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
+				p_init->phase = VL53L5CX_INIT_FW_CHECK;
+			}
+			break;
 
-	status |= _vl53l5cx_send_xtalk_data(p_dev, VL53L5CX_RESOLUTION_4X4);
+		case VL53L5CX_INIT_FW_CHECK:
+			/* Check if FW correctly downloaded */
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x02);
+			status |= WrByte(&(p_dev->platform), 0x03, 0x0D);
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x01);
+			_vl53l5cx_init_poll(p_dev, p_init, 1, 0, 0x21, 0x10, 0x10, VL53L5CX_INIT_MCU_RESET);
+			break;
 
-	/* Send default configuration to VL53L5CX firmware */
-	status |= WrMulti(&(p_dev->platform), 0x2c34, p_dev->default_configuration, sizeof(VL53L5CX_DEFAULT_CONFIGURATION));
+		case VL53L5CX_INIT_MCU_RESET:
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x0C, 0x01);
 
-	status |= _vl53l5cx_poll_for_answer(p_dev, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03);
+			/* Reset MCU and wait boot */
+			status |= WrByte(&(p_dev->platform), 0x7FFF, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x114, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x115, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x116, 0x42);
+			status |= WrByte(&(p_dev->platform), 0x117, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x0B, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x0C, 0x00);
+			status |= WrByte(&(p_dev->platform), 0x0B, 0x01);
+			_vl53l5cx_init_poll(p_dev, p_init, 1, 0, 0x06, 0xff, 0x00, VL53L5CX_INIT_NVM);
+			break;
+
+		case VL53L5CX_INIT_NVM:
+			status |= WrByte(&(p_dev->platform), 0x7fff, 0x02);
+
+			/* Get offset NVM data and store them into the offset buffer */
+			status |= WrMulti(&(p_dev->platform), 0x2fd8, (uint8_t *)VL53L5CX_GET_NVM_CMD, sizeof(VL53L5CX_GET_NVM_CMD));
+			_vl53l5cx_init_poll(p_dev, p_init, 4, 0, VL53L5CX_UI_CMD_STATUS, 0xff, 2, VL53L5CX_INIT_OFFSET);
+			break;
+
+		case VL53L5CX_INIT_OFFSET:
+			status |= RdMulti(&(p_dev->platform), VL53L5CX_UI_CMD_START, p_dev->temp_buffer, VL53L5CX_NVM_DATA_SIZE);
+			(void)memcpy(p_dev->offset_data, p_dev->temp_buffer, VL53L5CX_OFFSET_BUFFER_SIZE);
+
+			status |= _vl53l5cx_write_offset_data(p_dev, VL53L5CX_RESOLUTION_4X4);
+			_vl53l5cx_init_poll(p_dev, p_init, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03, VL53L5CX_INIT_XTALK);
+			break;
+
+		case VL53L5CX_INIT_XTALK:
+			/* Set default Xtalk shape. Send Xtalk to sensor */
+			(void)memcpy(p_dev->xtalk_data, (uint8_t *)VL53L5CX_DEFAULT_XTALK, VL53L5CX_XTALK_BUFFER_SIZE);
+
+			status |= _vl53l5cx_write_xtalk_data(p_dev, VL53L5CX_RESOLUTION_4X4);
+			_vl53l5cx_init_poll(p_dev, p_init, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03, VL53L5CX_INIT_CONFIG);
+			break;
+
+		case VL53L5CX_INIT_CONFIG:
+			/* Send default configuration to VL53L5CX firmware */
+			status |= WrMulti(&(p_dev->platform), 0x2c34, p_dev->default_configuration, sizeof(VL53L5CX_DEFAULT_CONFIGURATION));
+			_vl53l5cx_init_poll(p_dev, p_init, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03, VL53L5CX_INIT_PIPE);
+			break;
 
-	status |= vl53l5cx_dci_write_data(p_dev, (uint8_t *)&pipe_ctrl, VL53L5CX_DCI_PIPE_CONTROL, (uint16_t)sizeof(pipe_ctrl));
+		case VL53L5CX_INIT_PIPE:
+			status |= _vl53l5cx_dci_send_data(p_dev, (uint8_t *)&pipe_ctrl, VL53L5CX_DCI_PIPE_CONTROL, (uint16_t)sizeof(pipe_ctrl));
+			_vl53l5cx_init_poll(p_dev, p_init, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03, VL53L5CX_INIT_SINGLE_RANGE);
+			break;
 
+		case VL53L5CX_INIT_SINGLE_RANGE:
 #if VL53L5CX_NB_TARGET_PER_ZONE != 1
-	tmp = VL53L5CX_NB_TARGET_PER_ZONE;
-	status |= vl53l5cx_dci_replace_data(p_dev, p_dev->temp_buffer,
-										VL53L5CX_DCI_FW_NB_TARGET, 16,
-										(uint8_t *)&tmp, 1, 0x0C);
+			tmp = VL53L5CX_NB_TARGET_PER_ZONE;
+			status |= vl53l5cx_dci_replace_data(p_dev, p_dev->temp_buffer,
+												VL53L5CX_DCI_FW_NB_TARGET, 16,
+												(uint8_t *)&tmp, 1, 0x0C);
 #endif
+			status |= _vl53l5cx_dci_send_data(p_dev, (uint8_t *)&single_range, VL53L5CX_DCI_SINGLE_RANGE, (uint16_t)sizeof(single_range));
+			_vl53l5cx_init_poll(p_dev, p_init, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03, VL53L5CX_INIT_DONE);
+			break;
 
-	status |= vl53l5cx_dci_write_data(p_dev, (uint8_t *)&single_range, VL53L5CX_DCI_SINGLE_RANGE, (uint16_t)sizeof(single_range));
+		default:
+			status |= VL53L5CX_STATUS_ERROR;
+			break;
+		}
+
+		if ((GetTickMs(&(p_dev->platform)) - start_ms) >= budget_ms)
+		{
+			break;
+		}
+	}
+
+	if (status != VL53L5CX_STATUS_OK)
+	{
+		free(p_init->p_window);
+		p_init->p_window = NULL;
+		p_init->phase = VL53L5CX_INIT_FAILED;
+	}
+
+	*p_done = (p_init->phase == VL53L5CX_INIT_DONE) ? (uint8_t)1 : (uint8_t)0;
 
 	return status;
 }
@@ -428,6 +733,29 @@ uint8_t vl53l5cx_set_power_mode(VL53L5CX_Configuration *p_dev, uint8_t power_mod
 	return status;
 }
 
+uint8_t vl53l5cx_set_output_enable(VL53L5CX_Configuration *p_dev, uint32_t output_enable)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+
+	if ((output_enable & ~VL53L5CX_OUTPUT_ALL) != (uint32_t)0)
+	{
+		status |= VL53L5CX_STATUS_INVALID_PARAM;
+	}
+	else
+	{
+		p_dev->output_enable = output_enable;
+	}
+
+	return status;
+}
+
+uint8_t vl53l5cx_get_output_enable(VL53L5CX_Configuration *p_dev, uint32_t *p_output_enable)
+{
+	*p_output_enable = p_dev->output_enable;
+
+	return VL53L5CX_STATUS_OK;
+}
+
 uint8_t vl53l5cx_start_ranging(VL53L5CX_Configuration *p_dev)
 {
 	uint8_t resolution, status = VL53L5CX_STATUS_OK;
@@ -462,34 +790,36 @@ uint8_t vl53l5cx_start_ranging(VL53L5CX_Configuration *p_dev)
 						 VL53L5CX_TARGET_STATUS_BH,
 						 VL53L5CX_MOTION_DETECT_BH};
 
-	/* Enable selected outputs in the 'platform.h' file */
+	/* Enable outputs selected at runtime, among the ones kept in 'platform.h' */
+	uint32_t output_allowed = 0;
 #ifndef VL53L5CX_DISABLE_AMBIENT_PER_SPAD
-	output_bh_enable[0] += (uint32_t)8;
+	output_allowed |= VL53L5CX_OUTPUT_AMBIENT_PER_SPAD;
 #endif
 #ifndef VL53L5CX_DISABLE_NB_SPADS_ENABLED
-	output_bh_enable[0] += (uint32_t)16;
+	output_allowed |= VL53L5CX_OUTPUT_NB_SPADS_ENABLED;
 #endif
 #ifndef VL53L5CX_DISABLE_NB_TARGET_DETECTED
-	output_bh_enable[0] += (uint32_t)32;
+	output_allowed |= VL53L5CX_OUTPUT_NB_TARGET_DETECTED;
 #endif
 #ifndef VL53L5CX_DISABLE_SIGNAL_PER_SPAD
-	output_bh_enable[0] += (uint32_t)64;
+	output_allowed |= VL53L5CX_OUTPUT_SIGNAL_PER_SPAD;
 #endif
 #ifndef VL53L5CX_DISABLE_RANGE_SIGMA_MM
-	output_bh_enable[0] += (uint32_t)128;
+	output_allowed |= VL53L5CX_OUTPUT_RANGE_SIGMA_MM;
 #endif
 #ifndef VL53L5CX_DISABLE_DISTANCE_MM
-	output_bh_enable[0] += (uint32_t)256;
+	output_allowed |= VL53L5CX_OUTPUT_DISTANCE_MM;
 #endif
 #ifndef VL53L5CX_DISABLE_REFLECTANCE_PERCENT
-	output_bh_enable[0] += (uint32_t)512;
+	output_allowed |= VL53L5CX_OUTPUT_REFLECTANCE_PERCENT;
 #endif
 #ifndef VL53L5CX_DISABLE_TARGET_STATUS
-	output_bh_enable[0] += (uint32_t)1024;
+	output_allowed |= VL53L5CX_OUTPUT_TARGET_STATUS;
 #endif
 #ifndef VL53L5CX_DISABLE_MOTION_INDICATOR
-	output_bh_enable[0] += (uint32_t)2048;
+	output_allowed |= VL53L5CX_OUTPUT_MOTION_INDICATOR;
 #endif
+	output_bh_enable[0] |= output_allowed & p_dev->output_enable;
 
 	/* Update data size */
 	for (i = 0; i < (uint32_t)(sizeof(output) / sizeof(uint32_t)); i++)
@@ -607,13 +937,30 @@ uint8_t vl53l5cx_check_data_ready(VL53L5CX_Configuration *p_dev, uint8_t *p_isRe
 	return status;
 }
 
-uint8_t vl53l5cx_get_ranging_data(VL53L5CX_Configuration *p_dev, VL53L5CX_ResultsData *p_results)
+/**
+ * @brief Inner function, not available outside this file. Reads one 32-bit word
+ * of the frame, which is sent by the firmware most significant byte first.
+ */
+
+static inline uint32_t _vl53l5cx_frame_word(const uint8_t *p_src)
+{
+	uint32_t word;
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	(void)memcpy(&word, p_src, 4);
+	word = __builtin_bswap32(word);
+#else
+	word = ((uint32_t)p_src[0] << 24) | ((uint32_t)p_src[1] << 16)
+		   | ((uint32_t)p_src[2] << 8) | (uint32_t)p_src[3];
+#endif
+
+	return word;
+}
+
+uint8_t vl53l5cx_decode_results_reference(VL53L5CX_Configuration *p_dev, VL53L5CX_ResultsData *p_results)
 {
-	uint8_t status = VL53L5CX_STATUS_OK;
 	union Block_header *bh_ptr;
-	uint32_t i, j, msize;
-	status |= RdMulti(&(p_dev->platform), 0x0, p_dev->temp_buffer, p_dev->data_read_size);
-	p_dev->streamcount = p_dev->temp_buffer[0];
+	uint32_t i, j, msize, decoded = 0;
 	SwapBuffer(p_dev->temp_buffer, (uint16_t)p_dev->data_read_size);
 
 	/* Start conversion at position 16 to avoid headers */
@@ -634,46 +981,55 @@ uint8_t vl53l5cx_get_ranging_data(VL53L5CX_Configuration *p_dev, VL53L5CX_Result
 #ifndef VL53L5CX_DISABLE_AMBIENT_PER_SPAD
 		case VL53L5CX_AMBIENT_RATE_IDX:
 			(void)memcpy(p_results->ambient_per_spad, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_AMBIENT_PER_SPAD;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_NB_SPADS_ENABLED
 		case VL53L5CX_SPAD_COUNT_IDX:
 			(void)memcpy(p_results->nb_spads_enabled, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_NB_SPADS_ENABLED;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_NB_TARGET_DETECTED
 		case VL53L5CX_NB_TARGET_DETECTED_IDX:
 			(void)memcpy(p_results->nb_target_detected, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_NB_TARGET_DETECTED;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_SIGNAL_PER_SPAD
 		case VL53L5CX_SIGNAL_RATE_IDX:
 			(void)memcpy(p_results->signal_per_spad, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_SIGNAL_PER_SPAD;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_RANGE_SIGMA_MM
 		case VL53L5CX_RANGE_SIGMA_MM_IDX:
 			(void)memcpy(p_results->range_sigma_mm, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_RANGE_SIGMA_MM;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_DISTANCE_MM
 		case VL53L5CX_DISTANCE_IDX:
 			(void)memcpy(p_results->distance_mm, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_DISTANCE_MM;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_REFLECTANCE_PERCENT
 		case VL53L5CX_REFLECTANCE_EST_PC_IDX:
 			(void)memcpy(p_results->reflectance, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_REFLECTANCE_PERCENT;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_TARGET_STATUS
 		case VL53L5CX_TARGET_STATUS_IDX:
 			(void)memcpy(p_results->target_status, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_TARGET_STATUS;
 			break;
 #endif
 #ifndef VL53L5CX_DISABLE_MOTION_INDICATOR
 		case VL53L5CX_MOTION_DETEC_IDX:
 			(void)memcpy(&p_results->motion_indicator, &(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+			decoded |= VL53L5CX_OUTPUT_MOTION_INDICATOR;
 			break;
 #endif
 		default:
@@ -684,60 +1040,336 @@ uint8_t vl53l5cx_get_ranging_data(VL53L5CX_Configuration *p_dev, VL53L5CX_Result
 
 #ifndef VL53L5CX_USE_RAW_FORMAT
 
-	/* Convert data into their real format */
+	/* Convert data into their real format, only for blocks of this frame */
 #ifndef VL53L5CX_DISABLE_AMBIENT_PER_SPAD
-	for (i = 0; i < (uint32_t)VL53L5CX_RESOLUTION_8X8; i++)
+	if ((decoded & VL53L5CX_OUTPUT_AMBIENT_PER_SPAD) != (uint32_t)0)
 	{
-		p_results->ambient_per_spad[i] /= (uint32_t)2048;
+		for (i = 0; i < (uint32_t)VL53L5CX_RESOLUTION_8X8; i++)
+		{
+			p_results->ambient_per_spad[i] /= (uint32_t)2048;
+		}
 	}
 #endif
 
-	for (i = 0; i < (uint32_t)(VL53L5CX_RESOLUTION_8X8 * VL53L5CX_NB_TARGET_PER_ZONE); i++)
-	{
 #ifndef VL53L5CX_DISABLE_DISTANCE_MM
-		p_results->distance_mm[i] /= 4;
-		if (p_results->distance_mm[i] < 0)
+	if ((decoded & VL53L5CX_OUTPUT_DISTANCE_MM) != (uint32_t)0)
+	{
+		for (i = 0; i < (uint32_t)(VL53L5CX_RESOLUTION_8X8 * VL53L5CX_NB_TARGET_PER_ZONE); i++)
 		{
-			p_results->distance_mm[i] = 0;
+			p_results->distance_mm[i] /= 4;
+			if (p_results->distance_mm[i] < 0)
+			{
+				p_results->distance_mm[i] = 0;
+			}
 		}
+	}
 #endif
 #ifndef VL53L5CX_DISABLE_RANGE_SIGMA_MM
-		p_results->range_sigma_mm[i] /= (uint16_t)128;
+	if ((decoded & VL53L5CX_OUTPUT_RANGE_SIGMA_MM) != (uint32_t)0)
+	{
+		for (i = 0; i < (uint32_t)(VL53L5CX_RESOLUTION_8X8 * VL53L5CX_NB_TARGET_PER_ZONE); i++)
+		{
+			p_results->range_sigma_mm[i] /= (uint16_t)128;
+		}
+	}
 #endif
 #ifndef VL53L5CX_DISABLE_SIGNAL_PER_SPAD
-		p_results->signal_per_spad[i] /= (uint32_t)2048;
-#endif
+	if ((decoded & VL53L5CX_OUTPUT_SIGNAL_PER_SPAD) != (uint32_t)0)
+	{
+		for (i = 0; i < (uint32_t)(VL53L5CX_RESOLUTION_8X8 * VL53L5CX_NB_TARGET_PER_ZONE); i++)
+		{
+			p_results->signal_per_spad[i] /= (uint32_t)2048;
+		}
 	}
+#endif
 
 	/* Set target status to 255 if no target is detected for this zone */
-#ifndef VL53L5CX_DISABLE_NB_TARGET_DETECTED
-	for (i = 0; i < (uint32_t)VL53L5CX_RESOLUTION_8X8; i++)
+#if !defined(VL53L5CX_DISABLE_NB_TARGET_DETECTED) && !defined(VL53L5CX_DISABLE_TARGET_STATUS)
+	if ((decoded & (VL53L5CX_OUTPUT_NB_TARGET_DETECTED | VL53L5CX_OUTPUT_TARGET_STATUS))
+		== (VL53L5CX_OUTPUT_NB_TARGET_DETECTED | VL53L5CX_OUTPUT_TARGET_STATUS))
 	{
-		if (p_results->nb_target_detected[i] == (uint8_t)0)
+		for (i = 0; i < (uint32_t)VL53L5CX_RESOLUTION_8X8; i++)
 		{
-			for (j = 0; j < (uint32_t)
-								VL53L5CX_NB_TARGET_PER_ZONE;
-				 j++)
+			if (p_results->nb_target_detected[i] == (uint8_t)0)
 			{
-#ifndef VL53L5CX_DISABLE_TARGET_STATUS
-				p_results->target_status
-					[((uint32_t)VL53L5CX_NB_TARGET_PER_ZONE * (uint32_t)i) + j] = (uint8_t)255;
-#endif
+				for (j = 0; j < (uint32_t)
+									VL53L5CX_NB_TARGET_PER_ZONE;
+					 j++)
+				{
+					p_results->target_status
+						[((uint32_t)VL53L5CX_NB_TARGET_PER_ZONE * (uint32_t)i) + j] = (uint8_t)255;
+				}
 			}
 		}
 	}
 #endif
 
 #ifndef VL53L5CX_DISABLE_MOTION_INDICATOR
-	for (i = 0; i < (uint32_t)32; i++)
+	if ((decoded & VL53L5CX_OUTPUT_MOTION_INDICATOR) != (uint32_t)0)
 	{
-		p_results->motion_indicator.motion[i] /= (uint32_t)65535;
+		for (i = 0; i < (uint32_t)32; i++)
+		{
+			p_results->motion_indicator.motion[i] /= (uint32_t)65535;
+		}
 	}
 #endif
 
 #endif
+
+	return VL53L5CX_STATUS_OK;
+}
+
+/**
+ * @brief Inner functions, not available outside this file. Each one swaps a
+ * block word by word and writes it, scaled, into the results. They give the
+ * same values as SwapBuffer() followed by memcpy() and the scaling loops.
+ */
+
+static void _vl53l5cx_decode_bytes(uint8_t *p_dst, const uint8_t *p_src, uint32_t size)
+{
+	uint32_t i, word;
+
+	for (i = 0; i < size; i += (uint32_t)4)
+	{
+		word = _vl53l5cx_frame_word(&p_src[i]);
+		(void)memcpy(&p_dst[i], &word, 4);
+	}
+}
+
+static void _vl53l5cx_decode_u32(uint32_t *p_dst, const uint8_t *p_src, uint32_t size, uint8_t shift)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i += (uint32_t)4)
+	{
+		p_dst[i >> 2] = _vl53l5cx_frame_word(&p_src[i]) >> shift;
+	}
+}
+
+static void _vl53l5cx_decode_u16(uint16_t *p_dst, const uint8_t *p_src, uint32_t size, uint8_t shift)
+{
+	uint32_t i, word;
+	uint16_t half[2];
+
+	for (i = 0; i < size; i += (uint32_t)4)
+	{
+		word = _vl53l5cx_frame_word(&p_src[i]);
+		(void)memcpy(half, &word, 4);
+		p_dst[(i >> 1)] = (uint16_t)(half[0] >> shift);
+		p_dst[(i >> 1) + (uint32_t)1] = (uint16_t)(half[1] >> shift);
+	}
+}
+
+static void _vl53l5cx_decode_distance(int16_t *p_dst, const uint8_t *p_src, uint32_t size)
+{
+	uint32_t i, word;
+	int16_t half[2];
+
+	for (i = 0; i < size; i += (uint32_t)4)
+	{
+		word = _vl53l5cx_frame_word(&p_src[i]);
+		(void)memcpy(half, &word, 4);
+#ifndef VL53L5CX_USE_RAW_FORMAT
+		/* Same as '/ 4' then clamping negative distances to 0 */
+		p_dst[(i >> 1)] = (half[0] > 0) ? (int16_t)(half[0] >> 2) : (int16_t)0;
+		p_dst[(i >> 1) + (uint32_t)1] = (half[1] > 0) ? (int16_t)(half[1] >> 2) : (int16_t)0;
+#else
+		p_dst[(i >> 1)] = half[0];
+		p_dst[(i >> 1) + (uint32_t)1] = half[1];
+#endif
+	}
+}
+
+#ifndef VL53L5CX_USE_RAW_FORMAT
+#define VL53L5CX_SCALE_SHIFT(n)	((uint8_t)(n))
+#else
+#define VL53L5CX_SCALE_SHIFT(n)	((uint8_t)0)
+#endif
+
+uint8_t vl53l5cx_decode_results(VL53L5CX_Configuration *p_dev, VL53L5CX_ResultsData *p_results)
+{
+	union Block_header bh;
+	const uint8_t *p_src;
+	uint32_t i, msize, decoded = 0;
+
+	/* Start conversion at position 16 to avoid headers */
+	for (i = (uint32_t)16; i < (uint32_t)p_dev->data_read_size; i += (uint32_t)4)
+	{
+		bh.bytes = _vl53l5cx_frame_word(&(p_dev->temp_buffer[i]));
+		if ((bh.type > (uint32_t)0x1) && (bh.type < (uint32_t)0xd))
+		{
+			msize = bh.type * bh.size;
+		}
+		else
+		{
+			msize = bh.size;
+		}
+		p_src = &(p_dev->temp_buffer[i + (uint32_t)4]);
+
+		switch (bh.idx)
+		{
+#ifndef VL53L5CX_DISABLE_AMBIENT_PER_SPAD
+		case VL53L5CX_AMBIENT_RATE_IDX:
+			/* '/ 2048' */
+			_vl53l5cx_decode_u32(p_results->ambient_per_spad, p_src, msize, VL53L5CX_SCALE_SHIFT(11));
+			decoded |= VL53L5CX_OUTPUT_AMBIENT_PER_SPAD;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_NB_SPADS_ENABLED
+		case VL53L5CX_SPAD_COUNT_IDX:
+			_vl53l5cx_decode_u32(p_results->nb_spads_enabled, p_src, msize, 0);
+			decoded |= VL53L5CX_OUTPUT_NB_SPADS_ENABLED;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_NB_TARGET_DETECTED
+		case VL53L5CX_NB_TARGET_DETECTED_IDX:
+			_vl53l5cx_decode_bytes(p_results->nb_target_detected, p_src, msize);
+			decoded |= VL53L5CX_OUTPUT_NB_TARGET_DETECTED;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_SIGNAL_PER_SPAD
+		case VL53L5CX_SIGNAL_RATE_IDX:
+			/* '/ 2048' */
+			_vl53l5cx_decode_u32(p_results->signal_per_spad, p_src, msize, VL53L5CX_SCALE_SHIFT(11));
+			decoded |= VL53L5CX_OUTPUT_SIGNAL_PER_SPAD;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_RANGE_SIGMA_MM
+		case VL53L5CX_RANGE_SIGMA_MM_IDX:
+			/* '/ 128' */
+			_vl53l5cx_decode_u16(p_results->range_sigma_mm, p_src, msize, VL53L5CX_SCALE_SHIFT(7));
+			decoded |= VL53L5CX_OUTPUT_RANGE_SIGMA_MM;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_DISTANCE_MM
+		case VL53L5CX_DISTANCE_IDX:
+			_vl53l5cx_decode_distance(p_results->distance_mm, p_src, msize);
+			decoded |= VL53L5CX_OUTPUT_DISTANCE_MM;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_REFLECTANCE_PERCENT
+		case VL53L5CX_REFLECTANCE_EST_PC_IDX:
+			_vl53l5cx_decode_bytes(p_results->reflectance, p_src, msize);
+			decoded |= VL53L5CX_OUTPUT_REFLECTANCE_PERCENT;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_TARGET_STATUS
+		case VL53L5CX_TARGET_STATUS_IDX:
+			_vl53l5cx_decode_bytes(p_results->target_status, p_src, msize);
+			decoded |= VL53L5CX_OUTPUT_TARGET_STATUS;
+			break;
+#endif
+#ifndef VL53L5CX_DISABLE_MOTION_INDICATOR
+		case VL53L5CX_MOTION_DETEC_IDX:
+			_vl53l5cx_decode_bytes((uint8_t *)&p_results->motion_indicator, p_src, msize);
+#ifndef VL53L5CX_USE_RAW_FORMAT
+			for (uint32_t j = 0; j < (uint32_t)32; j++)
+			{
+				p_results->motion_indicator.motion[j] /= (uint32_t)65535;
+			}
+#endif
+			decoded |= VL53L5CX_OUTPUT_MOTION_INDICATOR;
+			break;
+#endif
+		default:
+			break;
+		}
+		i += msize;
+	}
+
+	/* Set target status to 255 if no target is detected for this zone */
+#if !defined(VL53L5CX_USE_RAW_FORMAT) && !defined(VL53L5CX_DISABLE_NB_TARGET_DETECTED) && !defined(VL53L5CX_DISABLE_TARGET_STATUS)
+	if ((decoded & (VL53L5CX_OUTPUT_NB_TARGET_DETECTED | VL53L5CX_OUTPUT_TARGET_STATUS))
+		== (VL53L5CX_OUTPUT_NB_TARGET_DETECTED | VL53L5CX_OUTPUT_TARGET_STATUS))
+	{
+		for (i = 0; i < (uint32_t)VL53L5CX_RESOLUTION_8X8; i++)
+		{
+			if (p_results->nb_target_detected[i] == (uint8_t)0)
+			{
+				(void)memset(&(p_results->target_status[(uint32_t)VL53L5CX_NB_TARGET_PER_ZONE * i]),
+							 255, VL53L5CX_NB_TARGET_PER_ZONE);
+			}
+		}
+	}
+#else
+	(void)decoded;
+#endif
+
+	return VL53L5CX_STATUS_OK;
+}
+
+uint8_t vl53l5cx_get_ranging_data(VL53L5CX_Configuration *p_dev, VL53L5CX_ResultsData *p_results)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+
+	status |= RdMulti(&(p_dev->platform), 0x0, p_dev->temp_buffer, p_dev->data_read_size);
+	p_dev->streamcount = p_dev->temp_buffer[0];
+#ifdef VL53L5CX_REFERENCE_DECODE
+	status |= vl53l5cx_decode_results_reference(p_dev, p_results);
+#else
+	status |= vl53l5cx_decode_results(p_dev, p_results);
+#endif
+
+	return status;
+}
+
+#ifndef VL53L5CX_DISABLE_DISTANCE_MM
+uint8_t vl53l5cx_get_ranging_distance(VL53L5CX_Configuration *p_dev, int16_t *p_distance, const uint8_t *p_zone_map, int16_t invalid_value)
+{
+	uint8_t status = VL53L5CX_STATUS_OK;
+	union Block_header bh;
+	uint32_t i, j, k, msize, word, element, zone;
+	int16_t half[2], distance;
+
+	status |= RdMulti(&(p_dev->platform), 0x0, p_dev->temp_buffer, p_dev->data_read_size);
+	p_dev->streamcount = p_dev->temp_buffer[0];
+
+	/* Start at position 16 to avoid headers, stop after the distance block */
+	for (i = (uint32_t)16; i < (uint32_t)p_dev->data_read_size; i += (uint32_t)4)
+	{
+		bh.bytes = _vl53l5cx_frame_word(&(p_dev->temp_buffer[i]));
+		if ((bh.type > (uint32_t)0x1) && (bh.type < (uint32_t)0xd))
+		{
+			msize = bh.type * bh.size;
+		}
+		else
+		{
+			msize = bh.size;
+		}
+
+		if (bh.idx == (uint32_t)VL53L5CX_DISTANCE_IDX)
+		{
+			for (k = 0; k < msize; k += (uint32_t)4)
+			{
+				word = _vl53l5cx_frame_word(&(p_dev->temp_buffer[i + (uint32_t)4 + k]));
+				(void)memcpy(half, &word, 4);
+
+				/* Each word holds two values, keep the first target of each zone */
+				for (j = 0; j < (uint32_t)2; j++)
+				{
+					element = (k >> 1) + j;
+					if ((element % (uint32_t)VL53L5CX_NB_TARGET_PER_ZONE) != (uint32_t)0)
+					{
+						continue;
+					}
+					zone = element / (uint32_t)VL53L5CX_NB_TARGET_PER_ZONE;
+#ifndef VL53L5CX_USE_RAW_FORMAT
+					distance = (int16_t)(half[j] >> 2);
+#else
+					distance = half[j];
+#endif
+					p_distance[(p_zone_map != NULL) ? p_zone_map[zone] : zone] =
+						(distance > 0) ? distance : invalid_value;
+				}
+			}
+			break;
+		}
+		i += msize;
+	}
+
 	return status;
 }
+#endif
 
 uint8_t vl53l5cx_get_resolution(VL53L5CX_Configuration *p_dev, uint8_t *p_resolution)
 {
@@ -994,45 +1626,11 @@ uint8_t vl53l5cx_dci_read_data(VL53L5CX_Configuration *p_dev, uint8_t *data, uin
 uint8_t vl53l5cx_dci_write_data(VL53L5CX_Configuration *p_dev, uint8_t *data, uint32_t index, uint16_t data_size)
 {
 	uint8_t status = VL53L5CX_STATUS_OK;
-	int16_t i;
-
-	uint8_t headers[] = {0x00, 0x00, 0x00, 0x00};
-	uint8_t footer[] = {0x00, 0x00, 0x00, 0x0f, 0x05, 0x01,
-						(uint8_t)((data_size + (uint16_t)8) >> 8),
-						(uint8_t)((data_size + (uint16_t)8) & (uint8_t)0xFF)};
-
-	uint16_t address = (uint16_t)VL53L5CX_UI_CMD_END -
-					   (data_size + (uint16_t)12) + (uint16_t)1;
 
-	/* Check if cmd buffer is large enough */
-	if ((data_size + (uint16_t)12) > (uint16_t)VL53L5CX_TEMPORARY_BUFFER_SIZE)
+	status |= _vl53l5cx_dci_send_data(p_dev, data, index, data_size);
+	if (status == VL53L5CX_STATUS_OK)
 	{
-		status |= VL53L5CX_STATUS_ERROR;
-	}
-	else
-	{
-		headers[0] = (uint8_t)(index >> 8);
-		headers[1] = (uint8_t)(index & (uint32_t)0xff);
-		headers[2] = (uint8_t)(((data_size & (uint16_t)0xff0) >> 4));
-		headers[3] = (uint8_t)((data_size & (uint16_t)0xf) << 4);
-
-		/* Copy data from structure to FW format (+4 bytes to add header) */
-		SwapBuffer(data, data_size);
-		for (i = (int16_t)data_size - (int16_t)1; i >= 0; i--)
-		{
-			p_dev->temp_buffer[i + 4] = data[i];
-		}
-
-		/* Add headers and footer */
-		(void)memcpy(&p_dev->temp_buffer[0], headers, sizeof(headers));
-		(void)memcpy(&p_dev->temp_buffer[data_size + (uint16_t)4],
-					 footer, sizeof(footer));
-
-		/* Send data to FW */
-		status |= WrMulti(&(p_dev->platform), address, p_dev->temp_buffer, (uint32_t)((uint32_t)data_size + (uint32_t)12));
 		status |= _vl53l5cx_poll_for_answer(p_dev, 4, 1, VL53L5CX_UI_CMD_STATUS, 0xff, 0x03);
-
-		SwapBuffer(data, data_size);
 	}
 
 	return status;
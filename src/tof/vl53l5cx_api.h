@@ -68,6 +68,7 @@
 #endif
 
 #include "platform.h"
+#include "vl53l5cx_lz.h"
 
 /**
  * @brief Current driver version.
@@ -297,6 +298,24 @@
 #define VL53L5CX_TEMPORARY_BUFFER_SIZE ((uint32_t) VL53L5CX_MAX_RESULTS_SIZE)
 #endif
 
+/**
+ * @brief Macros VL53L5CX_OUTPUT_* select the result blocks streamed by the
+ * sensor at runtime (see vl53l5cx_set_output_enable()). Values match the bits
+ * of the firmware output enable list. Blocks disabled in the 'platform.h' file
+ * are never streamed, whatever the runtime selection.
+ */
+
+#define VL53L5CX_OUTPUT_AMBIENT_PER_SPAD	((uint32_t) 8U)
+#define VL53L5CX_OUTPUT_NB_SPADS_ENABLED	((uint32_t) 16U)
+#define VL53L5CX_OUTPUT_NB_TARGET_DETECTED	((uint32_t) 32U)
+#define VL53L5CX_OUTPUT_SIGNAL_PER_SPAD		((uint32_t) 64U)
+#define VL53L5CX_OUTPUT_RANGE_SIGMA_MM		((uint32_t) 128U)
+#define VL53L5CX_OUTPUT_DISTANCE_MM		((uint32_t) 256U)
+#define VL53L5CX_OUTPUT_REFLECTANCE_PERCENT	((uint32_t) 512U)
+#define VL53L5CX_OUTPUT_TARGET_STATUS		((uint32_t) 1024U)
+#define VL53L5CX_OUTPUT_MOTION_INDICATOR	((uint32_t) 2048U)
+#define VL53L5CX_OUTPUT_ALL			((uint32_t) 0xFF8U)
+
 /**
  * @brief Structure VL53L5CX_Configuration contains the sensor configuration.
  * User MUST not manually change these field, except for the sensor address.
@@ -310,6 +329,8 @@ typedef struct
 	uint8_t		        streamcount;
 	/* Size of data read though I2C */
 	uint32_t	        data_read_size;
+	/* Result blocks selected at runtime (VL53L5CX_OUTPUT_* bits) */
+	uint32_t	        output_enable;
 	/* Address of default configuration buffer */
 	uint8_t		        *default_configuration;
 	/* Address of default Xtalk buffer */
@@ -411,6 +432,66 @@ uint8_t vl53l5cx_is_alive(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				*p_is_alive);
 
+/**
+ * @brief Phases of the non-blocking initialization. They follow the sections
+ * of vl53l5cx_init(): SW reboot, firmware download, MCU boot, NVM read, offset
+ * and Xtalk send, then default configuration.
+ */
+
+#define VL53L5CX_INIT_REBOOT			((uint8_t) 0U)
+#define VL53L5CX_INIT_WAIT			((uint8_t) 1U)
+#define VL53L5CX_INIT_POLL			((uint8_t) 2U)
+#define VL53L5CX_INIT_BOOT			((uint8_t) 3U)
+#define VL53L5CX_INIT_FW_ACCESS			((uint8_t) 4U)
+#define VL53L5CX_INIT_POWER_ON			((uint8_t) 5U)
+#define VL53L5CX_INIT_FW_DOWNLOAD		((uint8_t) 6U)
+#define VL53L5CX_INIT_FW_CHECK			((uint8_t) 7U)
+#define VL53L5CX_INIT_MCU_RESET			((uint8_t) 8U)
+#define VL53L5CX_INIT_NVM			((uint8_t) 9U)
+#define VL53L5CX_INIT_OFFSET			((uint8_t) 10U)
+#define VL53L5CX_INIT_XTALK			((uint8_t) 11U)
+#define VL53L5CX_INIT_CONFIG			((uint8_t) 12U)
+#define VL53L5CX_INIT_PIPE			((uint8_t) 13U)
+#define VL53L5CX_INIT_SINGLE_RANGE		((uint8_t) 14U)
+#define VL53L5CX_INIT_DONE			((uint8_t) 15U)
+#define VL53L5CX_INIT_FAILED			((uint8_t) 16U)
+
+/**
+ * @brief Largest firmware slice written by one step of the non-blocking
+ * initialization (about 12 ms of bus time at 400 kHz), and timeout applied to
+ * each wait for a firmware answer.
+ */
+
+#define VL53L5CX_INIT_SLICE_SIZE		((uint32_t)512U)
+#define VL53L5CX_INIT_POLL_TIMEOUT_MS		((uint32_t)2000U)
+
+/**
+ * @brief Structure VL53L5CX_InitState holds the progress of a non-blocking
+ * initialization. It is owned by the caller and must stay valid until the
+ * initialization is done or failed.
+ */
+
+typedef struct
+{
+	/* Current phase, and phase to resume after a wait or a poll */
+	uint8_t			phase;
+	uint8_t			next_phase;
+	/* Start time of the current wait or poll, and wait length */
+	uint32_t		mark_ms;
+	uint32_t		wait_ms;
+	/* Answer expected by the current poll */
+	uint16_t		poll_address;
+	uint8_t			poll_size;
+	uint8_t			poll_pos;
+	uint8_t			poll_mask;
+	uint8_t			poll_expected;
+	/* Firmware bytes already written */
+	uint32_t		fw_pos;
+	/* Compressed firmware stream and its window */
+	VL53L5CX_LzStream	lz;
+	uint8_t			*p_window;
+} VL53L5CX_InitState;
+
 /**
  * @brief Mandatory function used to initialize the sensor. This function must
  * be called after a power on, to load the firmware into the VL53L5CX. It takes
@@ -422,6 +503,37 @@ uint8_t vl53l5cx_is_alive(
 uint8_t vl53l5cx_init(
 		VL53L5CX_Configuration		*p_dev);
 
+/**
+ * @brief This function starts a non-blocking initialization. It only resets
+ * the state, no I2C access is done. Call vl53l5cx_init_step() until p_done is
+ * set to 1.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (VL53L5CX_InitState) *p_init : Initialization state.
+ * @return (uint8_t) status : 0 if OK.
+ */
+
+uint8_t vl53l5cx_init_start(
+		VL53L5CX_Configuration		*p_dev,
+		VL53L5CX_InitState		*p_init);
+
+/**
+ * @brief This function advances a non-blocking initialization. It does units
+ * of work (a group of register writes, one firmware slice, or one status read)
+ * until the time budget is spent or the sensor has to be waited for. At least
+ * one unit is done per call, so a budget of 0 gives the finest slicing.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (VL53L5CX_InitState) *p_init : Initialization state.
+ * @param (uint32_t) budget_ms : Time budget for this call in ms.
+ * @param (uint8_t) *p_done : Set to 1 when the initialization is complete.
+ * @return (uint8_t) status : 0 if OK. Any error ends the initialization.
+ */
+
+uint8_t vl53l5cx_init_step(
+		VL53L5CX_Configuration		*p_dev,
+		VL53L5CX_InitState		*p_init,
+		uint32_t			budget_ms,
+		uint8_t				*p_done);
+
 /**
  * @brief This function is used to change the I2C address of the sensor. If
  * multiple VL53L5 sensors are connected to the same I2C line, all other LPn
@@ -466,6 +578,32 @@ uint8_t vl53l5cx_set_power_mode(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				power_mode);
 
+/**
+ * @brief This function selects the result blocks streamed by the sensor, using
+ * VL53L5CX_OUTPUT_* bits. Blocks not selected are not sent over I2C and are
+ * not decoded by vl53l5cx_get_ranging_data(), so their fields keep their
+ * previous value. The selection is applied by the next
+ * vl53l5cx_start_ranging(). All blocks are selected after vl53l5cx_init().
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (uint32_t) output_enable : OR of VL53L5CX_OUTPUT_* bits.
+ * @return (uint8_t) status : 0 if the selection is OK.
+ */
+
+uint8_t vl53l5cx_set_output_enable(
+		VL53L5CX_Configuration		*p_dev,
+		uint32_t			output_enable);
+
+/**
+ * @brief This function gets the result blocks selected at runtime.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (uint32_t) *p_output_enable : OR of VL53L5CX_OUTPUT_* bits.
+ * @return (uint8_t) status : 0 if the selection is OK.
+ */
+
+uint8_t vl53l5cx_get_output_enable(
+		VL53L5CX_Configuration		*p_dev,
+		uint32_t			*p_output_enable);
+
 /**
  * @brief This function starts a ranging session. When the sensor streams, host
  * cannot change settings 'on-the-fly'.
@@ -511,6 +649,49 @@ uint8_t vl53l5cx_get_ranging_data(
 		VL53L5CX_Configuration		*p_dev,
 		VL53L5CX_ResultsData		*p_results);
 
+/**
+ * @brief These functions decode the frame that vl53l5cx_get_ranging_data()
+ * read into temp_buffer. vl53l5cx_decode_results() swaps, copies and scales
+ * each block in a single pass and leaves temp_buffer untouched.
+ * vl53l5cx_decode_results_reference() is the original ST decoder: it swaps
+ * temp_buffer in place, then copies, then scales. Both give the same results;
+ * the macro VL53L5CX_REFERENCE_DECODE selects the one used by
+ * vl53l5cx_get_ranging_data().
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (VL53L5CX_ResultsData) *p_results : VL53L5 results structure.
+ * @return (uint8_t) status : 0 if decoding is OK.
+ */
+
+uint8_t vl53l5cx_decode_results(
+		VL53L5CX_Configuration		*p_dev,
+		VL53L5CX_ResultsData		*p_results);
+
+uint8_t vl53l5cx_decode_results_reference(
+		VL53L5CX_Configuration		*p_dev,
+		VL53L5CX_ResultsData		*p_results);
+
+/**
+ * @brief This function gets only the distance of the first target of each
+ * zone, decoded straight from the I2C buffer into a caller array. It avoids a
+ * full VL53L5CX_ResultsData when only distances are needed. Other blocks of the
+ * frame are skipped.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (int16_t) *p_distance : Distances in mm, one per zone (16 or 64).
+ * @param (const uint8_t) *p_zone_map : Optional, index in p_distance of each
+ * sensor zone. NULL keeps the sensor order.
+ * @param (int16_t) invalid_value : Value written for zones without a positive
+ * distance.
+ * @return (uint8_t) status : 0 data are successfully get.
+ */
+
+#ifndef VL53L5CX_DISABLE_DISTANCE_MM
+uint8_t vl53l5cx_get_ranging_distance(
+		VL53L5CX_Configuration		*p_dev,
+		int16_t				*p_distance,
+		const uint8_t			*p_zone_map,
+		int16_t				invalid_value);
+#endif
+
 /**
  * @brief This function gets the current resolution (4x4 or 8x8).
  * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
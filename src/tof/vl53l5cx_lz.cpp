@@ -0,0 +1,67 @@
+/*
+  Loka — streaming LZSS decoder for the VL53L5CX firmware image.
+*/
+
+#include "vl53l5cx_lz.h"
+
+void vl53l5cx_lz_init(VL53L5CX_LzStream *p_lz, const uint8_t *p_src, uint8_t *p_window)
+{
+	p_lz->src = p_src;
+	p_lz->src_pos = 0;
+	p_lz->window = p_window;
+	p_lz->win_pos = 0;
+	p_lz->match_off = 0;
+	p_lz->match_left = 0;
+	p_lz->flags = 0;
+	p_lz->flag_bits = 0;
+}
+
+uint16_t vl53l5cx_lz_read(VL53L5CX_LzStream *p_lz, uint16_t max_size, uint8_t **pp_out)
+{
+	const uint16_t mask = VL53L5CX_LZ_WINDOW_SIZE - (uint16_t)1;
+	uint16_t size = VL53L5CX_LZ_WINDOW_SIZE - p_lz->win_pos;
+	uint16_t i;
+	uint8_t b0, b1;
+
+	if (size > max_size)
+	{
+		size = max_size;
+	}
+	*pp_out = &(p_lz->window[p_lz->win_pos]);
+
+	for (i = 0; i < size; i++)
+	{
+		if (p_lz->match_left == (uint8_t)0)
+		{
+			if (p_lz->flag_bits == (uint8_t)0)
+			{
+				p_lz->flags = p_lz->src[p_lz->src_pos++];
+				p_lz->flag_bits = 8;
+			}
+
+			if ((p_lz->flags & (uint8_t)1) != (uint8_t)0)
+			{
+				/* Literal: read before write keeps the window consistent */
+				p_lz->window[p_lz->win_pos] = p_lz->src[p_lz->src_pos++];
+				p_lz->win_pos = (p_lz->win_pos + (uint16_t)1) & mask;
+				p_lz->flags >>= 1;
+				p_lz->flag_bits--;
+				continue;
+			}
+
+			b0 = p_lz->src[p_lz->src_pos++];
+			b1 = p_lz->src[p_lz->src_pos++];
+			p_lz->match_off = (uint16_t)(b0 | ((uint16_t)(b1 >> 4) << 8)) + (uint16_t)1;
+			p_lz->match_left = (uint8_t)((b1 & (uint8_t)0x0F) + (uint8_t)3);
+			p_lz->flags >>= 1;
+			p_lz->flag_bits--;
+		}
+
+		p_lz->window[p_lz->win_pos] =
+			p_lz->window[(uint16_t)(p_lz->win_pos - p_lz->match_off) & mask];
+		p_lz->win_pos = (p_lz->win_pos + (uint16_t)1) & mask;
+		p_lz->match_left--;
+	}
+
+	return size;
+}
@@ -0,0 +1,65 @@
+/*
+  Loka — streaming LZSS decoder for the VL53L5CX firmware image.
+
+  The compressed image is produced by tools/vl53l5cx_lz.py (see that file for
+  the stream format). Decoding happens in place inside a 4 KB ring window, so
+  the caller can hand each decoded slice straight to WrMulti() without ever
+  holding the full firmware in RAM.
+*/
+
+#ifndef VL53L5CX_LZ_H_
+#define VL53L5CX_LZ_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Size of the ring window, which is also the maximum match distance
+ * used by the encoder. Must be a power of 2.
+ */
+
+#define VL53L5CX_LZ_WINDOW_SIZE		((uint16_t)4096U)
+
+typedef struct
+{
+	/* Compressed stream, read sequentially */
+	const uint8_t	*src;
+	uint32_t	src_pos;
+	/* Ring window of VL53L5CX_LZ_WINDOW_SIZE bytes, supplied by the caller */
+	uint8_t		*window;
+	uint16_t	win_pos;
+	/* Pending back-reference */
+	uint16_t	match_off;
+	uint8_t		match_left;
+	/* Current flag byte and number of tokens left in it */
+	uint8_t		flags;
+	uint8_t		flag_bits;
+} VL53L5CX_LzStream;
+
+/**
+ * @brief Prepares a stream for decoding.
+ * @param (VL53L5CX_LzStream) *p_lz : Stream state.
+ * @param (const uint8_t) *p_src : Compressed image.
+ * @param (uint8_t) *p_window : Ring window of VL53L5CX_LZ_WINDOW_SIZE bytes.
+ */
+
+void vl53l5cx_lz_init(
+		VL53L5CX_LzStream		*p_lz,
+		const uint8_t			*p_src,
+		uint8_t				*p_window);
+
+/**
+ * @brief Decodes the next slice of the image into the window. The slice is
+ * contiguous, so it is cut short at the end of the ring. The caller is
+ * responsible for not reading past the uncompressed size.
+ * @param (VL53L5CX_LzStream) *p_lz : Stream state.
+ * @param (uint16_t) max_size : Maximum number of bytes to decode.
+ * @param (uint8_t) **pp_out : Set to the start of the decoded slice.
+ * @return (uint16_t) size : Number of bytes decoded.
+ */
+
+uint16_t vl53l5cx_lz_read(
+		VL53L5CX_LzStream		*p_lz,
+		uint16_t			max_size,
+		uint8_t				**pp_out);
+
+#endif /* VL53L5CX_LZ_H_ */
@@ -0,0 +1,105 @@
+// Arduino.h for the host tests: just enough of the core for the library,
+// backed by the virtual clock and pin model in host.cpp
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <initializer_list>
+#include <algorithm>
+
+typedef uint8_t byte;
+
+#define PROGMEM
+#define F(x) x
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define IRAM_ATTR
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define digitalPinToInterrupt(p) (p)
+
+template<class A, class B> auto min(A a, B b) -> decltype(a + b) { return a < b ? a : b; }
+template<class A, class B> auto max(A a, B b) -> decltype(a + b) { return a > b ? a : b; }
+template<class T, class L, class H> T constrain(T x, L lo, H hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+void noInterrupts();
+void interrupts();
+
+#if defined(ARDUINO_ARCH_ESP32)
+bool ledcAttach(uint8_t pin, uint32_t freq, uint8_t resolution);
+bool ledcWrite(uint8_t pin, uint32_t duty);
+#endif
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n) { size_t i = 0; while (i < n && write(buf[i])) i++; return i; }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf_("%d", v); }
+  size_t print(unsigned int v) { return printf_("%u", v); }
+  size_t print(long v) { return printf_("%ld", v); }
+  size_t print(unsigned long v) { return printf_("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf_("%.*f", digits, v); }
+  size_t println() { return write("\r\n"); }
+  template<class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+  size_t println(double v, int digits) { size_t n = print(v, digits); return n + println(); }
+  size_t printf(const char* fmt, ...);
+
+private:
+  size_t printf_(const char* fmt, ...);
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(uint8_t* buf, size_t n) {
+    size_t i = 0;
+    while (i < n && available()) buf[i++] = (uint8_t)read();
+    return i;
+  }
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
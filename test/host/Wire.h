@@ -0,0 +1,64 @@
+// Wire.h for the host tests: transactions go to FakeI2CDevice models attached by address
+#pragma once
+#include "Arduino.h"
+
+// Same limit as the ESP32 core, so the drivers' chunking is exercised
+#ifndef I2C_BUFFER_LENGTH
+#define I2C_BUFFER_LENGTH 128
+#endif
+
+// A device on the fake bus. Writes arrive as whole transactions; stop is false
+// when a repeated start follows. Returning false NACKs the transaction.
+class FakeI2CDevice {
+public:
+  virtual ~FakeI2CDevice() {}
+  virtual bool write(const uint8_t* data, size_t len, bool stop) = 0;
+  virtual size_t read(uint8_t* data, size_t len) = 0;
+};
+
+class TwoWire : public Stream {
+public:
+  bool begin() { return true; }
+  bool begin(int sda, int scl) { (void)sda; (void)scl; return true; }
+  void setClock(uint32_t hz) { _clockHz = hz; }
+  uint32_t getClock() const { return _clockHz; }
+
+  void beginTransmission(uint8_t addr);
+  void beginTransmission(int addr) { beginTransmission((uint8_t)addr); }
+  uint8_t endTransmission(bool stop = true);
+
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t n) override;
+  using Print::write;
+
+  template<class A, class N> size_t requestFrom(A addr, N len) { return request_((uint8_t)addr, (size_t)len); }
+  template<class A, class N> size_t requestFrom(A addr, N len, bool stop) { (void)stop; return request_((uint8_t)addr, (size_t)len); }
+
+  int available() override { return (int)(_rxLen - _rxPos); }
+  int read() override { return _rxPos < _rxLen ? _rx[_rxPos++] : -1; }
+  int peek() override { return _rxPos < _rxLen ? _rx[_rxPos] : -1; }
+
+  // Test side
+  void attach(uint8_t addr, FakeI2CDevice* dev) { _dev[addr & 0x7f] = dev; }
+  void detach(uint8_t addr) { _dev[addr & 0x7f] = nullptr; }
+  uint32_t transactions() const { return _transactions; }
+  uint32_t bytes() const { return _bytes; }
+  void resetCounters() { _transactions = 0; _bytes = 0; }
+
+private:
+  FakeI2CDevice* _dev[128] = {};
+  uint32_t _clockHz = 100000;
+  uint8_t _txAddr = 0;
+  uint8_t _tx[I2C_BUFFER_LENGTH];
+  size_t _txLen = 0;
+  bool _txOverflow = false;
+  uint8_t _rx[I2C_BUFFER_LENGTH];
+  size_t _rxLen = 0, _rxPos = 0;
+  uint32_t _transactions = 0;
+  uint32_t _bytes = 0;
+
+  size_t request_(uint8_t addr, size_t len);
+  void charge_(size_t n);
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,132 @@
+// A BNO08x sensor hub at the SH-2 level, on top of the SHTP framing, for the
+// host tests.
+//
+// The soft reset the driver sends from begin() is answered with the
+// advertisement and a reset-complete, the product id request with four ids.
+// Set Feature commands are kept per report id, so tests can check the
+// interval and batch interval each sensor was last given. Input reports go
+// out on inputNormal the way a batch flushes: one base timestamp reference,
+// then the records, each with its own delay after that reference.
+#pragma once
+#include <string>
+#include "fake_shtp.h"
+
+class FakeSH2 : public FakeSHTP {
+public:
+  enum { CH_COMMAND, CH_EXECUTABLE, CH_CONTROL, CH_NORMAL, CH_WAKE, CH_GYRO_RV };
+
+  struct Feature {
+    uint32_t sets;        // Set Feature commands received
+    uint32_t intervalUs;
+    uint32_t batchUs;
+  };
+
+  // One input report: sequence number, time after the base reference in
+  // 100 us steps, and the raw fixed-point values
+  struct Record {
+    uint8_t id;
+    uint8_t seq;
+    uint16_t delay;
+    int16_t v[4];
+  };
+
+  // Observed
+  Feature feature[256] = {};
+  uint32_t resets = 0;
+
+  // The hub restarts on its own: reset-complete without an advertisement
+  void reset() {
+    resets++;
+    const uint8_t done = 1;
+    queue(CH_EXECUTABLE, &done, 5);
+  }
+
+  // Queues one packet of records whose base reference lies baseAgo x 100 us
+  // before the packet is read
+  void batch(const Record* r, size_t n, uint32_t baseAgo) {
+    std::vector<uint8_t> p(4, 0);
+    const uint8_t ref[5] = {0xFB, (uint8_t)baseAgo, (uint8_t)(baseAgo >> 8),
+                            (uint8_t)(baseAgo >> 16), (uint8_t)(baseAgo >> 24)};
+    p.insert(p.end(), ref, ref + sizeof(ref));
+    for (size_t i = 0; i < n; i++) {
+      uint8_t rec[12] = {r[i].id, r[i].seq, (uint8_t)(3 | (r[i].delay >> 8) << 2), (uint8_t)r[i].delay};
+      for (int k = 0; k < 4; k++) {
+        rec[4 + 2 * k] = (uint8_t)r[i].v[k];
+        rec[5 + 2 * k] = (uint8_t)(r[i].v[k] >> 8);
+      }
+      p.insert(p.end(), rec, rec + reportLen(r[i].id));
+    }
+    queue(CH_NORMAL, &p[4], (uint16_t)p.size());
+  }
+
+  static uint8_t reportLen(uint8_t id) {
+    for (size_t i = 0; i + 1 < sizeof(kLengths); i += 2) {
+      if (kLengths[i] == id) return kLengths[i + 1];
+    }
+    return 0;
+  }
+
+  bool write(const uint8_t* data, size_t len, bool stop) override {
+    FakeSHTP::write(data, len, stop);
+    if (len < 5) return true;
+    const uint8_t* p = data + 4;
+    if (data[2] == CH_EXECUTABLE && p[0] == 1) {
+      resets++;
+      advertise();
+    } else if (data[2] == CH_CONTROL && p[0] == 0xF9) {
+      uint8_t ids[4 * 16] = {};
+      for (int i = 0; i < 4; i++) ids[16 * i] = 0xF8;
+      queue(CH_CONTROL, ids, sizeof(ids) + 4);
+    } else if (data[2] == CH_CONTROL && p[0] == 0xFD && len >= 4 + 17) {
+      Feature& f = feature[p[1]];
+      f.sets++;
+      f.intervalUs = u32(p + 5);
+      f.batchUs = u32(p + 9);
+    }
+    return true;
+  }
+
+private:
+  // Report ids and lengths the sensorhub advertises
+  static constexpr uint8_t kLengths[] = {
+    0xF1, 16, 0xF3, 16, 0xF4, 16, 0xF8, 16, 0xFA, 5, 0xFB, 5, 0xFC, 17, 0xEF, 2,
+    0x01, 10, 0x02, 10, 0x08, 12, 0x10, 5, 0x2A, 14,
+  };
+
+  static uint32_t u32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+  }
+
+  void tlv(std::vector<uint8_t>& a, uint8_t tag, const void* v, uint8_t len) {
+    a.push_back(tag);
+    a.push_back(len);
+    a.insert(a.end(), (const uint8_t*)v, (const uint8_t*)v + len);
+  }
+  void app(std::vector<uint8_t>& a, uint32_t guid, const char* name) {
+    tlv(a, 1, &guid, 4);
+    tlv(a, 8, name, (uint8_t)(strlen(name) + 1));
+  }
+  void chan(std::vector<uint8_t>& a, uint8_t no, const char* name, bool wake = false) {
+    tlv(a, wake ? 7 : 6, &no, 1);
+    tlv(a, 9, name, (uint8_t)(strlen(name) + 1));
+  }
+
+  // Channel numbers as the BNO085 gives them
+  void advertise() {
+    std::vector<uint8_t> a(5, 0);  // header, then RESP_ADVERTISE
+    app(a, 0, "SHTP");
+    chan(a, CH_COMMAND, "command");
+    app(a, 1, "executable");
+    chan(a, CH_EXECUTABLE, "device");
+    app(a, 2, "sensorhub");
+    tlv(a, 0x80, "fake", 5);
+    tlv(a, 0x81, kLengths, sizeof(kLengths));
+    chan(a, CH_CONTROL, "control");
+    chan(a, CH_NORMAL, "inputNormal");
+    chan(a, CH_WAKE, "inputWake", true);
+    chan(a, CH_GYRO_RV, "inputGyroRv");
+    queue(CH_COMMAND, &a[4], (uint16_t)a.size());
+    const uint8_t done = 1;
+    queue(CH_EXECUTABLE, &done, 5);
+  }
+};
@@ -0,0 +1,77 @@
+// SHTP framing of a BNO08x hub on I2C, for the host tests.
+//
+// The hub hands out one queued packet at a time. Every read starts with a
+// 4 byte header: the packet's own header on the first read, then a
+// continuation header (bit 15 of the length set, length = what is left plus
+// the header) on each later read, followed by as much of the remaining cargo
+// as fits. Reading only the header first, as the driver does to size the
+// transfer, does not consume the packet. With nothing queued a read returns a
+// zero header.
+#pragma once
+#include <deque>
+#include <vector>
+#include "host.h"
+
+class FakeSHTP : public FakeI2CDevice {
+public:
+  // Observed
+  std::vector<std::vector<uint8_t> > written;
+  uint32_t reads = 0;
+  size_t maxRead = 0;
+
+  // Queues a packet of size bytes, header included, cargo taken from cargo
+  void queue(uint8_t channel, const uint8_t* cargo, uint16_t size) {
+    std::vector<uint8_t> p(size, 0);
+    p[0] = (uint8_t)size;
+    p[1] = (uint8_t)(size >> 8);
+    p[2] = channel;
+    p[3] = _seq[channel & 7]++;
+    if (size > 4) memcpy(&p[4], cargo, size - 4);
+    _queue.push_back(p);
+  }
+
+  bool pending() const { return !_queue.empty(); }
+
+  bool write(const uint8_t* data, size_t len, bool stop) override {
+    (void)stop;
+    if (len) written.push_back(std::vector<uint8_t>(data, data + len));
+    return true;
+  }
+
+  size_t read(uint8_t* data, size_t len) override {
+    reads++;
+    if (len > maxRead) maxRead = len;
+    memset(data, 0, len);
+    if (_queue.empty()) return len;
+
+    const std::vector<uint8_t>& p = _queue.front();
+    const uint16_t left = (uint16_t)(p.size() - _pos);
+    const bool first = !_started;
+    if (first) {
+      memcpy(data, p.data(), len < 4 ? len : 4);
+    } else {
+      const uint16_t hdr = (uint16_t)((left + 4) | 0x8000);
+      const uint8_t cont[4] = {(uint8_t)hdr, (uint8_t)(hdr >> 8), p[2], p[3]};
+      memcpy(data, cont, len < 4 ? len : 4);
+    }
+    _started = true;
+    if (len > 4) {
+      const size_t n = (len - 4 < left) ? len - 4 : left;
+      memcpy(data + 4, &p[_pos], n);
+      _pos += n;
+    }
+    // A first read of just the header leaves even a cargo-less packet queued
+    if (_pos >= p.size() && !(first && len <= 4)) {
+      _queue.pop_front();
+      _pos = 4;
+      _started = false;
+    }
+    return len;
+  }
+
+private:
+  std::deque<std::vector<uint8_t> > _queue;
+  size_t _pos = 4;       // next cargo byte of the front packet
+  bool _started = false; // its first header went out
+  uint8_t _seq[8] = {};
+};
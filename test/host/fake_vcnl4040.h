@@ -0,0 +1,36 @@
+// VCNL4040 register map for the host tests: 16-bit little endian command
+// codes, no auto-increment; INT_FLAG clears on read.
+#pragma once
+#include "host.h"
+
+class FakeVCNL4040 : public FakeI2CDevice {
+public:
+  uint16_t reg[16] = {};
+  uint32_t writes = 0, reads = 0;
+
+  FakeVCNL4040() {
+    reg[0x00] = 0x0001;  // power-on defaults: ALS, PS and white shut down
+    reg[0x03] = 0x0001;
+    reg[0x0C] = 0x0186;
+  }
+
+  bool write(const uint8_t* data, size_t len, bool stop) override {
+    (void)stop;
+    if (len < 1 || data[0] > 0x0C) return false;
+    _ptr = data[0];
+    if (len == 3) { reg[_ptr] = (uint16_t)(data[1] | data[2] << 8); writes++; }
+    return len == 1 || len == 3;
+  }
+
+  size_t read(uint8_t* data, size_t len) override {
+    reads++;
+    const uint16_t v = reg[_ptr];
+    if (_ptr == 0x0B) reg[0x0B] = 0;
+    if (len > 0) data[0] = (uint8_t)v;
+    if (len > 1) data[1] = (uint8_t)(v >> 8);
+    return len;
+  }
+
+private:
+  uint8_t _ptr = 0;
+};
@@ -0,0 +1,208 @@
+// Register-level model of a VL53L5CX for the host tests.
+//
+// It implements what the ST driver relies on: the 0x7fff page register, the
+// boot and MCU reset polls, firmware capture from page 0x09 on, the UI command
+// area of page 2 with its status word, DCI reads and writes, and frames built
+// from the output list the driver sends in vl53l5cx_start_ranging(). Each frame
+// n reports the same distance in every zone, so a reader can tell torn frames
+// from whole ones.
+#pragma once
+#include <map>
+#include <vector>
+#include "host.h"
+#include "vl53l5cx_api.h"
+
+class FakeVL53L5CX : public FakeI2CDevice {
+public:
+  // Script
+  uint32_t bootMs = 5;        // reboot or MCU reset until reg 0x06 answers
+  uint32_t cmdMs = 3;         // UI command latency
+  bool hangCommands = false;  // status word never reports done
+  bool mcuError = false;      // status word reports an MCU error
+  int32_t nackAfter = -1;     // write transactions before the part stops ACKing
+  uint32_t payloadSeed = 0;   // non-zero: every block carries pseudo-random bytes instead
+
+  // Observed
+  std::vector<uint8_t> fw;    // image written to pages 0x09 on
+  uint32_t fwBytes = 0;
+  uint32_t commands = 0;
+  uint32_t writes = 0;
+  bool ranging = false;
+  std::map<uint16_t, std::vector<uint8_t> > dci;  // as sent on the wire, words big-endian
+
+  static int16_t ZoneMm(uint32_t frame) { return (int16_t)(100 + frame % 1000); }
+
+  FakeVL53L5CX() : fw(3 * 0x8000, 0) {
+    for (int p = 0; p < 3; p++) _mem[p].assign(0x8000, 0);
+    _mem[0][0x00] = 0xF0;  // device id
+    _mem[0][0x01] = 0x02;  // revision
+  }
+
+  // Frames completed so far, by the frequency the driver set
+  uint32_t frames() {
+    if (!ranging) return _frames;
+    const uint64_t now = hostMicros64();
+    while (now >= _nextFrameUs) {
+      _frames++;
+      _nextFrameUs += 1000000 / rateHz();
+    }
+    return _frames;
+  }
+
+  uint8_t rateHz() {
+    std::map<uint16_t, std::vector<uint8_t> >::iterator it = dci.find(VL53L5CX_DCI_FREQ_HZ);
+    // data[1] of the host struct is byte 2 of the first wire word
+    if (it == dci.end() || it->second.size() < 4 || it->second[2] == 0) return 15;
+    return it->second[2];
+  }
+
+  bool write(const uint8_t* data, size_t len, bool stop) override {
+    (void)stop;
+    writes++;
+    if (nackAfter >= 0 && (int32_t)writes > nackAfter) return false;
+    if (len < 2) return true;  // address probe
+    uint16_t addr = (uint16_t)((data[0] << 8) | data[1]);
+    _ptr = addr;
+    if (len == 2) return true;  // register pointer for a read
+    if (len == 3 && addr == 0x7fff) { _page = data[2]; return true; }
+
+    const uint16_t start = addr;
+    for (size_t i = 2; i < len; i++, addr++) store_(addr, data[i]);
+    if (_page == 2 && (uint32_t)start + (len - 2) - 1 == VL53L5CX_UI_CMD_END) command_(start, len - 2);
+    return true;
+  }
+
+  size_t read(uint8_t* data, size_t len) override {
+    if (_page == 2 && _ptr == 0 && ranging) buildFrame_();
+    for (size_t i = 0; i < len; i++) data[i] = load_(_ptr++);
+    return len;
+  }
+
+private:
+  std::vector<uint8_t> _mem[3];
+  uint8_t _page = 0;
+  uint16_t _ptr = 0;
+  uint64_t _readyUs = 0;      // reg 0x06 flips from _r06Before to _r06After
+  uint8_t _r06Before = 0, _r06After = 0;
+  uint64_t _cmdUs = 0;        // status word done from here
+  uint32_t _frames = 0;
+  uint64_t _nextFrameUs = 0;
+  std::vector<uint8_t> _frame;
+
+  void store_(uint16_t addr, uint8_t v) {
+    if (_page >= 0x09) {
+      // A full firmware page ends on the page register, as on the part: the byte was still sent
+      const uint32_t pos = (uint32_t)(_page - 0x09) * 0x8000 + (addr & 0x7fff);
+      if (pos < fw.size()) { fw[pos] = v; fwBytes++; }
+      if (addr == 0x7fff) _page = v;
+      return;
+    }
+    if (addr == 0x7fff) { _page = v; return; }
+    if (_page > 2) return;
+    _mem[_page][addr & 0x7fff] = v;
+    if (_page != 0) return;
+    if (addr == 0x0009 && v == 0x04 && !ranging) flip06_(0, 1);  // SW reboot
+    if (addr == 0x000B && v == 0x01) flip06_(1, 0);              // MCU reset
+    if (addr == 0x0009 && v == 0x04 && ranging) ranging = false; // stop xshut bypass
+    if (addr == 0x0014 && v == 0x01) { ranging = false; flip06_(0, 0x80); }  // MCU stop
+  }
+
+  void flip06_(uint8_t before, uint8_t after) {
+    _r06Before = before;
+    _r06After = after;
+    _readyUs = hostMicros64() + (uint64_t)bootMs * 1000;
+  }
+
+  uint8_t load_(uint16_t addr) {
+    if (addr == 0x7fff) return _page;
+    if (_page == 2) {
+      if (addr >= VL53L5CX_UI_CMD_STATUS && addr < VL53L5CX_UI_CMD_STATUS + 4) return status_(addr - VL53L5CX_UI_CMD_STATUS);
+      if (ranging && addr < _frame.size()) return _frame[addr];
+    }
+    if (_page == 0 && addr == 0x06) return hostMicros64() >= _readyUs ? _r06After : _r06Before;
+    if (_page == 1 && addr == 0x21) return 0x10;  // firmware access granted
+    if (_page > 2) return 0;
+    return _mem[_page][addr & 0x7fff];
+  }
+
+  uint8_t status_(uint16_t i) {
+    const bool done = !hangCommands && hostMicros64() >= _cmdUs;
+    if (mcuError && i == 2) return 0x7f;
+    if (!done) return 0;
+    static const uint8_t ok[4] = {0x02, 0x03, 0x00, 0x00};  // NVM answers 2 in byte 0, the rest 3 in byte 1
+    return ok[i];
+  }
+
+  // A write just ended at UI_CMD_END: the firmware picks up the command
+  void command_(uint16_t start, size_t len) {
+    uint8_t* m = _mem[2].data();
+    commands++;
+    _cmdUs = hostMicros64() + (uint64_t)cmdMs * 1000;
+
+    if (start == 0x2FFC && len == 4 && m[0x2FFD] == 0x03) {
+      ranging = true;
+      _frames = 0;
+      _nextFrameUs = _cmdUs + 1000000 / rateHz();
+    } else if (start == 0x2FF4 && len == 12 && m[0x2FFD] == 0x02) {
+      const uint16_t idx = (uint16_t)((m[0x2FF4] << 8) | m[0x2FF5]);
+      const uint16_t size = (uint16_t)((m[0x2FF6] << 4) | (m[0x2FF7] >> 4));
+      std::vector<uint8_t>& d = dci[idx];
+      if (d.size() < size) d.resize(size, 0);
+      memcpy(&m[VL53L5CX_UI_CMD_START], &m[0x2FF4], 4);
+      memcpy(&m[VL53L5CX_UI_CMD_START + 4], d.data(), size);
+      memset(&m[VL53L5CX_UI_CMD_START + 4 + size], 0, 8);
+    } else if (m[0x2FFB] == 0x0F && m[0x2FFC] == 0x05) {
+      const uint16_t size = (uint16_t)(((m[0x2FFE] << 8) | m[0x2FFF]) - 8);
+      if ((uint32_t)size + 12 > (uint32_t)(VL53L5CX_UI_CMD_END - VL53L5CX_UI_CMD_START)) return;
+      const uint16_t at = (uint16_t)(VL53L5CX_UI_CMD_END - (size + 12) + 1);
+      const uint16_t idx = (uint16_t)((m[at] << 8) | m[at + 1]);
+      dci[idx].assign(&m[at + 4], &m[at + 4 + size]);
+    }
+  }
+
+  static uint32_t be32_(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+  }
+
+  static void put32_(std::vector<uint8_t>& out, uint32_t w) {
+    out.push_back((uint8_t)(w >> 24)); out.push_back((uint8_t)(w >> 16));
+    out.push_back((uint8_t)(w >> 8)); out.push_back((uint8_t)w);
+  }
+
+  // Header, then every enabled block of the output list in order, then the footer
+  void buildFrame_() {
+    const uint32_t n = frames();
+    const std::vector<uint8_t>& list = dci[VL53L5CX_DCI_OUTPUT_LIST];
+    const std::vector<uint8_t>& en = dci[VL53L5CX_DCI_OUTPUT_ENABLES];
+    _frame.assign(16, 0);
+    _frame[0] = n ? (uint8_t)(n % 255) : 255;  // stream count, 255 until the first frame
+    _frame[1] = 0x05;
+    _frame[2] = 0x05;
+    _frame[3] = 0x10;
+    for (size_t i = 0; i + 4 <= list.size(); i += 4) {
+      const uint32_t bit = (uint32_t)(i / 4);
+      if ((bit / 32) * 4 + 4 > en.size() || !(be32_(&en[(bit / 32) * 4]) & (1u << (bit % 32)))) continue;
+      const uint32_t bh = be32_(&list[i]);
+      if (bh == 0) continue;
+      const uint32_t type = bh & 0xf, size = (bh >> 4) & 0xfff, idx = bh >> 16;
+      const uint32_t bytes = (type >= 1 && type < 0xd) ? type * size : size;
+      put32_(_frame, bh);
+      const size_t at = _frame.size();
+      _frame.resize(at + bytes, 0);
+      if (payloadSeed) {
+        uint32_t x = payloadSeed ^ (n * 2654435761u) ^ (idx << 8);
+        for (uint32_t k = 0; k < bytes; k++) {
+          x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+          _frame[at + k] = (uint8_t)x;
+        }
+      } else if (idx == VL53L5CX_DISTANCE_IDX) {
+        const uint16_t raw = (uint16_t)(ZoneMm(n) * 4);
+        for (uint32_t k = 0; k < bytes; k += 2) {  // one value per zone, MSB first within each half word
+          _frame[at + k] = (uint8_t)(raw >> 8);
+          _frame[at + k + 1] = (uint8_t)raw;
+        }
+      }
+    }
+    _frame.resize(_frame.size() + 4, 0);
+  }
+};
@@ -0,0 +1,32 @@
+// FreeRTOS for the host tests: tasks are std::threads, see host.cpp
+#pragma once
+#include <stdint.h>
+
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostSem* SemaphoreHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+#define configMAX_PRIORITIES 25
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+// Spinlock with the ESP-IDF layout; on the host only the mutual exclusion matters
+typedef struct { int lock; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void hostMuxEnter(portMUX_TYPE* mux);
+void hostMuxExit(portMUX_TYPE* mux);
+#define portENTER_CRITICAL(mux) hostMuxEnter(mux)
+#define portEXIT_CRITICAL(mux) hostMuxExit(mux)
+#define portENTER_CRITICAL_ISR(mux) hostMuxEnter(mux)
+#define portEXIT_CRITICAL_ISR(mux) hostMuxExit(mux)
+
+BaseType_t xPortGetCoreID();
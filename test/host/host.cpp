@@ -0,0 +1,276 @@
+// Host platform for the tests: virtual clock, fake Wire bus, pins and
+// FreeRTOS tasks on std::thread
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "host.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+int hostFailures = 0;
+
+int hostReport(const char* name) {
+  if (hostFailures) {
+    fprintf(stderr, "%s: %d check(s) failed\n", name, hostFailures);
+    return 1;
+  }
+  printf("%s: ok\n", name);
+  return 0;
+}
+
+// ---- clock ----
+
+typedef std::chrono::steady_clock HostClock;
+
+static std::atomic<uint64_t> g_ns(0);       // virtual time, or the base in real time
+static std::atomic<bool> g_real(false);
+static HostClock::time_point g_t0;
+
+static uint64_t nowNs() {
+  if (!g_real) return g_ns;
+  return g_ns + std::chrono::duration_cast<std::chrono::nanoseconds>(HostClock::now() - g_t0).count();
+}
+
+void hostRealTime(bool on) {
+  if (on == g_real) return;
+  if (on) g_t0 = HostClock::now();
+  else g_ns = nowNs();
+  g_real = on;
+}
+
+uint64_t hostMicros64() { return nowNs() / 1000; }
+void hostSetMicros(uint64_t us) { g_ns = us * 1000; if (g_real) g_t0 = HostClock::now(); }
+void hostAdvance(uint64_t us) { if (!g_real) g_ns += us * 1000; }
+
+unsigned long millis() { return (unsigned long)(uint32_t)(nowNs() / 1000000); }
+unsigned long micros() { return (unsigned long)(uint32_t)(nowNs() / 1000); }
+
+void delay(unsigned long ms) {
+  if (g_real) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  else { g_ns += (uint64_t)ms * 1000000; std::this_thread::yield(); }
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (g_real) std::this_thread::sleep_for(std::chrono::microseconds(us));
+  else g_ns += (uint64_t)us * 1000;
+}
+
+void yield() { std::this_thread::yield(); }
+
+// ---- pins ----
+
+static int g_out[256];
+static int g_in[256];
+static uint32_t g_duty[256];
+static bool g_inInit = false;
+static void (*g_isr[256])(void);
+static void (*g_isrArg[256])(void*);
+static void* g_arg[256];
+
+// noInterrupts() holds off the fake ISRs, which run under the same lock
+static std::recursive_mutex g_irq;
+static thread_local int t_irqDepth = 0;
+
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+void digitalWrite(uint8_t pin, uint8_t val) { g_out[pin] = val; }
+
+int digitalRead(uint8_t pin) {
+  if (!g_inInit) { for (int i = 0; i < 256; i++) g_in[i] = HIGH; g_inInit = true; }
+  return g_in[pin];
+}
+
+void hostSetPin(uint8_t pin, int level) { digitalRead(pin); g_in[pin] = level; }
+int hostPinLevel(uint8_t pin) { return g_out[pin]; }
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) { (void)mode; g_isr[pin] = isr; g_isrArg[pin] = nullptr; }
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode) {
+  (void)mode; g_isr[pin] = nullptr; g_isrArg[pin] = isr; g_arg[pin] = arg;
+}
+void detachInterrupt(uint8_t pin) { g_isr[pin] = nullptr; g_isrArg[pin] = nullptr; }
+
+void noInterrupts() { g_irq.lock(); t_irqDepth++; }
+void interrupts() { if (t_irqDepth) { t_irqDepth--; g_irq.unlock(); } }
+
+void hostFireInterrupt(uint8_t pin) {
+  std::lock_guard<std::recursive_mutex> lock(g_irq);
+  if (g_isr[pin]) g_isr[pin]();
+  else if (g_isrArg[pin]) g_isrArg[pin](g_arg[pin]);
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+bool ledcAttach(uint8_t pin, uint32_t freq, uint8_t resolution) { (void)pin; (void)freq; (void)resolution; return true; }
+bool ledcWrite(uint8_t pin, uint32_t duty) { __atomic_store_n(&g_duty[pin], duty, __ATOMIC_RELAXED); return true; }
+#endif
+uint32_t hostPinDuty(uint8_t pin) { return __atomic_load_n(&g_duty[pin], __ATOMIC_RELAXED); }
+
+// ---- Serial ----
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+
+size_t Print::printf(const char* fmt, ...) {
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  return write(buf);
+}
+
+size_t Print::printf_(const char* fmt, ...) {
+  char buf[64];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  return write(buf);
+}
+
+// ---- Wire ----
+
+TwoWire Wire;
+
+// One bit per SCL cycle, 9 per byte with the ACK, plus start and stop
+void TwoWire::charge_(size_t n) {
+  if (!g_real) g_ns += ((uint64_t)n * 9 + 2) * 1000000000ull / _clockHz;
+  _transactions++;
+  _bytes += n;
+}
+
+void TwoWire::beginTransmission(uint8_t addr) {
+  _txAddr = addr;
+  _txLen = 0;
+  _txOverflow = false;
+}
+
+size_t TwoWire::write(uint8_t b) {
+  if (_txLen >= sizeof(_tx)) { _txOverflow = true; return 0; }
+  _tx[_txLen++] = b;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* buf, size_t n) {
+  size_t i = 0;
+  while (i < n && write(buf[i])) i++;
+  return i;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+  charge_(_txLen + 1);
+  if (_txOverflow) return 1;
+  FakeI2CDevice* dev = _dev[_txAddr & 0x7f];
+  if (!dev) return 2;
+  return dev->write(_tx, _txLen, stop) ? 0 : 3;
+}
+
+size_t TwoWire::request_(uint8_t addr, size_t len) {
+  _rxLen = _rxPos = 0;
+  if (len > sizeof(_rx)) return 0;
+  charge_(len + 1);
+  FakeI2CDevice* dev = _dev[addr & 0x7f];
+  if (!dev) return 0;
+  _rxLen = dev->read(_rx, len);
+  return _rxLen;
+}
+
+// ---- FreeRTOS ----
+
+struct HostTask {
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+};
+
+struct HostSem {
+  std::timed_mutex m;
+};
+
+static thread_local HostTask* t_self = nullptr;
+
+void hostMuxEnter(portMUX_TYPE* mux) {
+  while (__atomic_exchange_n(&mux->lock, 1, __ATOMIC_ACQUIRE)) std::this_thread::yield();
+}
+
+void hostMuxExit(portMUX_TYPE* mux) { __atomic_store_n(&mux->lock, 0, __ATOMIC_RELEASE); }
+
+BaseType_t xPortGetCoreID() { return t_self ? 1 : 0; }
+
+// Tasks are never joined: like on the chip, one ends by deleting itself.
+// The HostTask stays allocated so a late notify cannot touch freed memory.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* arg,
+                                   UBaseType_t prio, TaskHandle_t* handle, BaseType_t core) {
+  (void)name; (void)stack; (void)prio; (void)core;
+  HostTask* t = new HostTask;
+  if (handle) *handle = t;
+  std::thread([t, fn, arg] { t_self = t; fn(arg); }).detach();
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) { (void)task; }
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks) delay(ticks);
+  else std::this_thread::yield();
+}
+
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+
+BaseType_t xTaskDelayUntil(TickType_t* wake, TickType_t period) {
+  const TickType_t target = *wake + period;
+  *wake = target;
+  const int32_t left = (int32_t)(target - xTaskGetTickCount());
+  if (left <= 0) return pdFALSE;
+  if (g_real) {
+    const uint64_t until = (uint64_t)target * 1000000;
+    const uint64_t now = nowNs();
+    if (until > now) std::this_thread::sleep_for(std::chrono::nanoseconds(until - now));
+  } else {
+    delay(left);
+  }
+  return pdTRUE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return t_self; }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  HostTask* t = t_self;
+  if (!t) return 0;
+  std::unique_lock<std::mutex> lock(t->m);
+  t->cv.wait_for(lock, std::chrono::milliseconds(ticks), [t] { return t->notify > 0; });
+  const uint32_t n = t->notify;
+  if (clear) t->notify = 0;
+  else if (n) t->notify--;
+  return n;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  {
+    std::lock_guard<std::mutex> lock(task->m);
+    task->notify++;
+  }
+  task->cv.notify_one();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+  xTaskNotifyGive(task);
+  if (woken) *woken = pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSem; }
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  if (ticks == portMAX_DELAY) { sem->m.lock(); return pdTRUE; }
+  return sem->m.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  sem->m.unlock();
+  return pdTRUE;
+}
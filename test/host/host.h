@@ -0,0 +1,38 @@
+// Test side of the host platform: clock, pins and a minimal check macro
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+extern int hostFailures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      hostFailures++; \
+    } \
+  } while (0)
+
+#define CHECKF(cond, ...) do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, #cond); \
+      fprintf(stderr, __VA_ARGS__); \
+      fputc('\n', stderr); \
+      hostFailures++; \
+    } \
+  } while (0)
+
+// Prints the result line, returns the exit code for main()
+int hostReport(const char* name);
+
+// The clock is virtual by default: only delay() and bus traffic move it, so
+// timing checks are exact. Real time makes delay() sleep and the clock follow
+// the wall, for tests where FreeRTOS tasks run as threads.
+void hostRealTime(bool on);
+uint64_t hostMicros64();
+void hostSetMicros(uint64_t us);
+void hostAdvance(uint64_t us);
+
+int hostPinLevel(uint8_t pin);          // last digitalWrite()
+void hostSetPin(uint8_t pin, int level);  // what digitalRead() returns, default HIGH
+uint32_t hostPinDuty(uint8_t pin);      // last ledcWrite()
+void hostFireInterrupt(uint8_t pin);    // runs the attached handler as an ISR
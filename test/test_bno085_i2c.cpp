@@ -0,0 +1,129 @@
+// i2chal_read() against a fake SHTP hub: every packet from 4 to 384 bytes, for
+// chunk sizes from the smallest setI2CBufferSize() allows up to the Wire
+// buffer. Each later chunk repeats a 4 byte continuation header that must not
+// end up in the cargo, no read may exceed the chunk size and nothing past the
+// packet may be written.
+#include "host.h"
+#include "fake_shtp.h"
+#include "../src/mcu/BNO085.cpp"  // the HAL is file-static
+
+static const uint16_t kMaxPacket = 384;
+static sh2_Hal_t hal;  // i2chal_read() only passes it on
+
+static void fill(uint8_t* cargo, uint16_t size, uint32_t seed) {
+  uint32_t x = seed * 2654435761u + 1;
+  for (uint16_t i = 0; i < size; i++) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    cargo[i] = (uint8_t)x;
+  }
+}
+
+static void testPacketSizes(BNO085& imu, size_t chunk) {
+  FakeSHTP hub;
+  Wire.attach(0x4A, &hub);
+  imu.setI2CBufferSize(chunk);
+  CHECK(imu.getI2CBufferSize() == chunk);
+
+  uint32_t bad = 0;
+  for (uint16_t size = 4; size <= kMaxPacket; size++) {
+    uint8_t cargo[kMaxPacket];
+    uint8_t buf[kMaxPacket + 8];
+    uint32_t t_us;
+    fill(cargo, size - 4, size);
+    hub.queue(3, cargo, size);
+    memset(buf, 0xA5, sizeof(buf));
+
+    const int got = i2chal_read(&hal, buf, kMaxPacket, &t_us);
+    bool ok = got == size && (uint16_t)((buf[0] | buf[1] << 8) & 0x7fff) == size && buf[2] == 3;
+    ok = ok && memcmp(buf + 4, cargo, size - 4) == 0;
+    for (size_t i = size; i < sizeof(buf) && ok; i++) ok = buf[i] == 0xA5;
+    ok = ok && !hub.pending();
+    if (!ok && bad++ < 3) fprintf(stderr, "chunk %zu: packet of %u bytes read as %d\n", chunk, size, got);
+  }
+  CHECKF(bad == 0, "chunk %zu: %u packets wrong", chunk, bad);
+  CHECKF(hub.maxRead <= chunk, "chunk %zu: read of %zu bytes", chunk, hub.maxRead);
+  Wire.detach(0x4A);
+}
+
+// A packet longer than the caller's buffer is left alone, an idle hub reads as nothing
+static void testRejects(BNO085& imu) {
+  FakeSHTP hub;
+  Wire.attach(0x4A, &hub);
+  imu.setI2CBufferSize(BNO085_I2C_BUFFER_SIZE);
+  uint8_t cargo[kMaxPacket] = {};
+  uint8_t buf[kMaxPacket];
+  uint32_t t_us;
+  CHECK(i2chal_read(&hal, buf, sizeof(buf), &t_us) == 0);
+  hub.queue(2, cargo, 200);
+  CHECK(i2chal_read(&hal, buf, 100, &t_us) == 0);
+  CHECK(i2chal_read(&hal, buf, sizeof(buf), &t_us) == 200);
+  Wire.detach(0x4A);
+}
+
+// On H_INTN a packet is read only after an edge or while the line is low, and carries the
+// time of the edge rather than of the read
+static void testInterrupt(BNO085& imu) {
+  static const uint8_t kInt = 7;
+  FakeSHTP hub;
+  Wire.attach(0x4A, &hub);
+  imu.setI2CBufferSize(BNO085_I2C_BUFFER_SIZE);
+  uint8_t cargo[16] = {};
+  uint8_t buf[64];
+  uint32_t t_us;
+  hostSetPin(kInt, HIGH);
+  hostFireInterrupt(kInt);  // before useInterrupt(): not attached
+  CHECK(imu.useInterrupt(kInt));
+  hub.queue(3, cargo, 20);
+  CHECK(i2chal_read(&hal, buf, sizeof(buf), &t_us) == 0);
+  CHECK(!imu.dataReady());
+
+  hostFireInterrupt(kInt);
+  const uint32_t edge = micros();
+  CHECK(imu.dataReady());
+  delay(3);
+  CHECK(i2chal_read(&hal, buf, sizeof(buf), &t_us) == 20);
+  CHECKF(t_us == edge, "packet stamped %u, edge at %u", t_us, edge);
+  CHECK(!imu.dataReady());
+
+  hub.queue(3, cargo, 20);
+  hostSetPin(kInt, LOW);  // still low from an edge already taken
+  CHECK(i2chal_read(&hal, buf, sizeof(buf), &t_us) == 20);
+  CHECK(t_us > edge && t_us <= micros());  // stamped at the read, not with the old edge
+  hostSetPin(kInt, HIGH);
+
+  hostFireInterrupt(kInt);
+  imu.usePolling();  // drops the latched edge with the pin
+  CHECK(imu.dataReady());
+  CHECK(imu.useInterrupt(kInt));
+  CHECK(!imu.dataReady());
+  imu.usePolling();
+  Wire.detach(0x4A);
+}
+
+// The 64-bit timebase runs straight across a micros() wrap
+static void testTimeWrap(BNO085& imu) {
+  hostSetMicros(0xFFFFFFFFull - 100);
+  const uint64_t t0 = imu.getTimeUs();
+  hostAdvance(50);
+  const uint64_t t1 = imu.getTimeUs();
+  hostAdvance(100);
+  const uint64_t t2 = imu.getTimeUs();
+  CHECKF(t1 - t0 == 50 && t2 - t1 == 100, "steps of %llu and %llu us across the wrap",
+         (unsigned long long)(t1 - t0), (unsigned long long)(t2 - t1));
+  CHECK((uint32_t)t2 == (uint32_t)micros());
+}
+
+int main() {
+  _i2cPort = &Wire;
+  BNO085 imu;
+  static const size_t chunks[] = {8, 9, 16, 32, 33, 64, 127, BNO085_I2C_BUFFER_SIZE};
+  for (size_t chunk : chunks) testPacketSizes(imu, chunk);
+  imu.setI2CBufferSize(4);
+  CHECK(imu.getI2CBufferSize() == 8);
+  imu.setI2CBufferSize(1000);
+  CHECK(imu.getI2CBufferSize() == BNO085_I2C_BUFFER_SIZE);
+  testRejects(imu);
+  testInterrupt(imu);
+  testTimeWrap(imu);
+  return hostReport("bno085_i2c");
+}
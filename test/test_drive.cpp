@@ -0,0 +1,342 @@
+// LokaDrive against a simulated plant on the virtual clock: two wheels read
+// back from the PWM duty, the left one 15% weaker, each with a first-order
+// lag, and the yaw rate they produce fed back through the gyro hook. Checks
+// that feedback straightens a path the open loop keeps curving, that saturation
+// keeps the wheel ratio, that Stop(true) holds the brake without a twitch, that
+// heading hold turns to a target and holds it, and that it steps once per IMU
+// sample, not once per Update().
+#include "host.h"
+#include "LokaDrive.h"
+
+static const uint8_t kL1 = 1, kL2 = 2, kR1 = 3, kR2 = 4;
+static const float kTrack = 0.08f, kVmax = 0.5f;
+static const float kDt = 0.005f;
+
+struct Plant {
+  float gainL = 0.85f, gainR = 1.0f;
+  float tau = 0.05f;             // wheel speed lag, s
+  float vl = 0, vr = 0;          // m/s
+  float yaw = 0, x = 0, y = 0;
+
+  // Drive fraction of one bridge: the driven input's duty over the other's, in either decay mode
+  static float bridge(uint8_t in1, uint8_t in2) {
+    const float max = (float)((1u << LOKA_PWM_RES_BITS) - 1);
+    return ((float)hostPinDuty(in2) - (float)hostPinDuty(in1)) / max;
+  }
+
+  float rate() const { return (vr - vl) / kTrack; }
+
+  void step() {
+    const float a = kDt / tau;
+    vl += (bridge(kL1, kL2) * kVmax * gainL - vl) * a;
+    vr += (bridge(kR1, kR2) * kVmax * gainR - vr) * a;
+    const float v = 0.5f * (vl + vr);
+    yaw += rate() * kDt;
+    x += v * cosf(yaw) * kDt;
+    y += v * sinf(yaw) * kDt;
+  }
+};
+
+static Plant plant;
+static bool gyroZ(void *cookie, float &rate) { rate = static_cast<Plant*>(cookie)->rate(); return true; }
+static bool noGyro(void *cookie, float &rate) { (void)cookie; (void)rate; return false; }
+
+// A heading source reporting at its own rate: the sample time only moves every periodUs
+struct HeadingSource {
+  float yaw = 0.0f;
+  uint32_t periodUs = 20000;
+  bool frozen = false;
+  bool fail = false;
+  uint64_t last = 0;
+
+  static bool read(void *cookie, float &yaw, float &rate, uint64_t &sampleUs) {
+    HeadingSource& h = *static_cast<HeadingSource*>(cookie);
+    if (h.fail) return false;
+    if (!h.frozen || !h.last) h.last = (uint64_t)(micros() / h.periodUs) * h.periodUs + 1;
+    yaw = h.yaw;
+    rate = 0.0f;
+    sampleUs = h.last;
+    return true;
+  }
+};
+
+// The plant seen by an IMU at 100 Hz: yaw wrapped to +-pi and rate latched at each sample
+struct PlantImu {
+  uint32_t periodUs = 10000;
+  uint64_t last = 0;
+  float yaw = 0.0f, rate = 0.0f;
+
+  static bool read(void *cookie, float &yaw, float &rate, uint64_t &sampleUs) {
+    PlantImu& m = *static_cast<PlantImu*>(cookie);
+    const uint64_t t = (uint64_t)(micros() / m.periodUs) * m.periodUs + 1;
+    if (t != m.last) {
+      m.last = t;
+      m.yaw = atan2f(sinf(plant.yaw), cosf(plant.yaw));
+      m.rate = plant.rate();
+    }
+    yaw = m.yaw;
+    rate = m.rate;
+    sampleUs = m.last;
+    return true;
+  }
+};
+
+static void run(LokaDrive& drive, float seconds) {
+  for (int i = 0; i < (int)(seconds / kDt + 0.5f); i++) {
+    delay(5);
+    drive.Update();
+    plant.step();
+  }
+}
+
+// Heading after 3 s at 0.3 m/s, and how much of it came in the last second
+static float straightRun(bool hook, float& lastSecond) {
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  drive.Init();
+  drive.Geometry(kTrack, kVmax);
+  if (hook) drive.GyroHook(gyroZ, &plant);
+  plant = Plant();
+  drive.Drive(0.3f, 0.0f);
+  run(drive, 2.0f);
+  const float at2 = plant.yaw;
+  run(drive, 1.0f);
+  drive.Stop();
+  lastSecond = plant.yaw - at2;
+  return plant.yaw;
+}
+
+// The integral of the rate error acts on the heading, so the weak wheel costs a fixed angle
+// (the needed w over ki) and after that the path is straight; open loop it keeps curving
+static void testStraightLine() {
+  float openLate, heldLate;
+  const float open = straightRun(false, openLate);
+  const float held = straightRun(true, heldLate);
+  CHECKF(fabsf(openLate) > 0.4f, "open loop turned only %.3f rad in the last second", openLate);
+  CHECKF(fabsf(heldLate) < 0.05f * fabsf(openLate), "gyro hook still turned %.4f rad in the last second", heldLate);
+  CHECKF(fabsf(held) < 0.2f * fabsf(open), "gyro hook drifted %.3f rad, open loop %.3f", held, open);
+}
+
+// Both wheels scale together: the ratio, and so the curvature, is what was asked for
+static void testSaturationKeepsRatio() {
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  drive.Init();
+  drive.Geometry(kTrack, kVmax);
+  const float v = kVmax, w = 4.0f;
+  drive.Drive(v, w);
+  drive.Update();
+  const float want = (v - 0.5f * kTrack * w) / (v + 0.5f * kTrack * w);
+  CHECK(drive.Saturated());
+  CHECKF(fabsf(drive.RightPct() - 100.0f) < 0.01f, "right %.2f%%", drive.RightPct());
+  CHECKF(fabsf(drive.LeftPct() / drive.RightPct() - want) < 1e-4f, "ratio %.4f, want %.4f",
+         drive.LeftPct() / drive.RightPct(), want);
+  drive.Drive(0.1f, 0.0f);
+  drive.Update();
+  CHECK(!drive.Saturated());
+}
+
+// After Stop(true) every step leaves both bridges shorted, even with the gyro hook still seeing
+// the robot roll out and a deadband that would turn any leftover command into a kick
+static void testStopHoldsBrake() {
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  drive.Init();
+  drive.Geometry(kTrack, kVmax);
+  l.Deadband(15.0f);
+  r.Deadband(15.0f);
+  drive.GyroHook(gyroZ, &plant);
+  plant = Plant();
+  drive.Drive(0.3f, 1.0f);
+  run(drive, 1.0f);
+  CHECK(fabsf(plant.rate()) > 0.5f);
+
+  drive.Stop(true);
+  CHECK(drive.Stopped());
+  const uint32_t max = (1u << LOKA_PWM_RES_BITS) - 1;
+  uint32_t moved = 0;
+  for (int i = 0; i < 200; i++) {
+    delay(5);
+    drive.Update();
+    plant.step();
+    if (hostPinDuty(kL1) != max || hostPinDuty(kL2) != max || hostPinDuty(kR1) != max || hostPinDuty(kR2) != max) moved++;
+  }
+  CHECKF(moved == 0, "%u of 200 steps left the brake", moved);
+  CHECK(drive.LeftPct() == 0.0f && drive.RightPct() == 0.0f);
+
+  drive.Drive(0.2f, 0.0f);
+  CHECK(!drive.Stopped());
+  drive.Update();
+  CHECK(drive.LeftPct() > 0.0f && drive.RightPct() > 0.0f);
+}
+
+// 50 Hz samples under a 200 Hz loop: three steps in four reuse the last output, and the
+// integral still grows by ki * e per second of sample time. A source that stops reporting
+// keeps the last output for a few periods, then stops the turn without winding the integral
+// up on the last error; one that fails never hands the turn back to Drive()'s w.
+static void testHeadingSamples() {
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  drive.Init();
+  HeadingSource src;
+  drive.HeadingHook(HeadingSource::read, &src);
+  drive.HeadingGains(1.0f, 1.0f, 0.0f, 3.0f);
+  drive.HoldHeading(0.2f);
+  drive.Drive(0.0f, 0.0f);
+  run(drive, 1.0f);
+
+  LokaDriveTelemetry t;
+  drive.Telemetry(t);
+  CHECKF(t.steps >= 200 && t.stale >= 148 && t.stale <= 151, "%u stale of %u steps", t.stale, t.steps);
+  CHECKF(fabsf(t.i - 0.2f) < 0.01f, "integral %.4f after 1 s at 0.2 rad", t.i);
+  CHECKF(fabsf(t.wCmd - (0.2f + t.i)) < 1e-5f, "stale step put out %.4f", t.wCmd);
+
+  src.frozen = true;
+  run(drive, 0.02f);
+  drive.Telemetry(t);
+  const float i0 = t.i;
+  CHECK(!t.headingLost);
+  CHECKF(fabsf(t.wCmd - (0.2f + i0)) < 1e-5f, "frozen sample put out %.4f", t.wCmd);
+  run(drive, 0.1f);
+  drive.Telemetry(t);
+  CHECK(t.headingLost && t.holding && t.wCmd == 0.0f);
+  run(drive, 1.0f);
+  drive.Telemetry(t);
+  CHECK(t.headingLost && t.wCmd == 0.0f && drive.LeftPct() == 0.0f);
+
+  src.frozen = false;
+  run(drive, 0.005f);
+  drive.Telemetry(t);
+  CHECK(!t.headingLost);
+  CHECKF(fabsf(t.i - i0) < 0.002f, "integral moved from %.4f to %.4f over the outage", i0, t.i);
+
+  src.fail = true;
+  drive.Drive(0.0f, 1.0f);  // ignored while holding, with or without a heading
+  run(drive, 0.2f);
+  drive.Telemetry(t);
+  CHECK(t.headingLost && t.wCmd == 0.0f);
+  drive.Stop();
+
+  LokaDrive fresh(l, r);
+  fresh.Init();
+  fresh.HeadingHook(HeadingSource::read, &src);
+  fresh.HoldHeading(0.2f);
+  fresh.Drive(0.0f, 1.0f);
+  fresh.Update();
+  fresh.Telemetry(t);
+  CHECK(t.headingLost && t.wCmd == 0.0f);
+  fresh.Stop();
+}
+
+// A gyro with no sample yet leaves the step open loop: no correction, and no integral winding up
+// on a rate it takes for zero
+static void testNoGyroSample() {
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  drive.Init();
+  drive.Geometry(kTrack, kVmax);
+  drive.GyroHook(noGyro);
+  plant = Plant();
+  drive.Drive(0.2f, 1.0f);
+  run(drive, 2.0f);
+  LokaDriveTelemetry t;
+  drive.Telemetry(t);
+  CHECKF(t.wCmd == 1.0f, "w %.3f with no gyro sample", t.wCmd);
+  CHECK(!drive.Saturated());
+  drive.Stop();
+}
+
+// The PWM resolution given to Init() reaches the motors: a brake is full duty at 8 bits
+static void testInitPwm() {
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  CHECK(drive.Init(25000, 8));
+  drive.Stop(true);
+  CHECK(hostPinDuty(kL1) == 255 && hostPinDuty(kL2) == 255 && hostPinDuty(kR1) == 255 && hostPinDuty(kR2) == 255);
+}
+
+// Heading hold against the plant for seconds: the worst overshoot past target, the last time the
+// heading was outside band, and the largest integral term seen
+struct TurnTrace {
+  float over = 0.0f, settle = 0.0f, maxI = 0.0f;
+};
+
+static TurnTrace holdRun(LokaDrive& drive, float target, float seconds, float band) {
+  TurnTrace tr;
+  const float dir = target > plant.yaw ? 1.0f : -1.0f;
+  LokaDriveTelemetry t;
+  for (int i = 0; i < (int)(seconds / kDt + 0.5f); i++) {
+    run(drive, kDt);
+    if ((plant.yaw - target) * dir > tr.over) tr.over = (plant.yaw - target) * dir;
+    if (fabsf(plant.yaw - target) > band) tr.settle = (i + 1) * kDt;
+    drive.Telemetry(t);
+    if (fabsf(t.i) > tr.maxI) tr.maxI = fabsf(t.i);
+  }
+  return tr;
+}
+
+// TurnBy() on the plant, with both hooks as a sketch would set them and a 100 Hz IMU: a quarter
+// turn reaches its target and stays, a longer one pinned at wMax does not wind the integral up,
+// and with the wheels blocked the integral stops short of wMax and follows it down
+static void testTurn() {
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  drive.Init();
+  drive.Geometry(kTrack, kVmax);
+  PlantImu imu;
+  plant = Plant();
+  drive.GyroHook(gyroZ, &plant);
+  drive.HeadingHook(PlantImu::read, &imu);
+  drive.HoldHeading(0.0f);
+  drive.Drive(0.0f, 0.0f);
+  run(drive, 0.2f);
+
+  drive.TurnBy(HALF_PI);
+  TurnTrace tr = holdRun(drive, HALF_PI, 1.5f, 0.05f);
+  CHECKF(tr.settle < 1.0f, "quarter turn still %.3f rad off after %.2f s", plant.yaw - HALF_PI, tr.settle);
+  tr = holdRun(drive, HALF_PI, 8.5f, 0.05f);
+  CHECKF(tr.settle == 0.0f, "quarter turn left the 0.05 rad band at %.2f s", 1.5f + tr.settle);
+  CHECKF(tr.over < 0.06f, "quarter turn overshot by %.4f rad", tr.over);
+  CHECKF(fabsf(plant.yaw - HALF_PI) < 0.01f, "quarter turn ended %.4f rad off", plant.yaw - HALF_PI);
+
+  // 0.9 pi at wMax = 1: the output is pinned for about 2.5 s
+  drive.HeadingGains(4.0f, 1.0f, 0.2f, 1.0f);
+  LokaDriveTelemetry t;
+  drive.Telemetry(t);
+  const float i0 = fabsf(t.i);
+  const float target = HALF_PI + 0.9f * PI;
+  drive.TurnBy(0.9f * PI);
+  tr = holdRun(drive, target, 6.0f, 0.05f);
+  CHECKF(tr.maxI < i0 + 0.2f, "integral reached %.3f from %.3f while pinned", tr.maxI, i0);
+  CHECKF(tr.over < 0.06f, "pinned turn overshot by %.4f rad", tr.over);
+  CHECKF(tr.settle < 4.0f, "pinned turn still outside the band at %.2f s", tr.settle);
+
+  // Wheels blocked: the error never closes, the integral stops at the limit
+  plant.gainL = plant.gainR = 0.0f;
+  drive.HeadingGains(0.5f, 2.0f, 0.0f, 1.0f);
+  drive.TurnBy(0.2f);
+  tr = holdRun(drive, target + 0.2f, 4.0f, 0.05f);
+  drive.Telemetry(t);
+  const float i1 = t.i;
+  tr = holdRun(drive, target + 0.2f, 1.0f, 0.05f);
+  drive.Telemetry(t);
+  CHECKF(tr.maxI <= 1.0f + 1e-5f, "blocked: integral reached %.3f", tr.maxI);
+  CHECKF(fabsf(t.i - i1) < 1e-4f, "blocked: integral still moving, %.4f to %.4f", i1, t.i);
+
+  // A lower wMax takes the integral down with it, though the error still asks for more
+  drive.HeadingGains(0.5f, 2.0f, 0.0f, 0.3f);
+  tr = holdRun(drive, target + 0.2f, 0.5f, 0.05f);
+  CHECKF(tr.maxI <= 0.3f + 1e-5f, "blocked: integral %.3f over a 0.3 limit", tr.maxI);
+  drive.Stop();
+}
+
+int main() {
+  testInitPwm();
+  testStraightLine();
+  testNoGyroSample();
+  testSaturationKeepsRatio();
+  testStopHoldsBrake();
+  testHeadingSamples();
+  testTurn();
+  return hostReport("drive");
+}
@@ -0,0 +1,118 @@
+// LokaDrive with its task running while the sketch keeps commanding: every
+// command goes through the mailbox and only the task touches the controller
+// and the motors. Built with ThreadSanitizer, which reports any command that
+// still writes controller or motor state from the caller's thread.
+#include <atomic>
+#include "host.h"
+#include "LokaDrive.h"
+
+static const uint8_t kL1 = 1, kL2 = 2, kR1 = 3, kR2 = 4;
+static const uint32_t kMaxDuty = (1u << LOKA_PWM_RES_BITS) - 1;
+
+static std::atomic<float> g_yaw(0.0f);
+static std::atomic<uint64_t> g_sample(0);
+
+static bool heading(void *cookie, float &yaw, float &rate, uint64_t &sampleUs) {
+  (void)cookie;
+  yaw = g_yaw;
+  rate = 0.0f;
+  sampleUs = ++g_sample;
+  return true;
+}
+
+// A small bias keeps the rate loop busy
+static bool gyroZ(void *cookie, float &rate) { (void)cookie; rate = 0.05f; return true; }
+
+static bool braked() {
+  return hostPinDuty(kL1) == kMaxDuty && hostPinDuty(kL2) == kMaxDuty &&
+         hostPinDuty(kR1) == kMaxDuty && hostPinDuty(kR2) == kMaxDuty;
+}
+
+static void testCommands(LokaDrive& drive) {
+  LokaDriveTelemetry t;
+  drive.Drive(0.2f, 0.0f);
+  CHECK(!drive.Stopped());
+  delay(30);
+  CHECK(drive.LeftPct() > 0.0f && drive.RightPct() > 0.0f);
+
+  // Pending commands read back as done; TurnBy() adds to the target in order
+  drive.HoldHeading(1.0f);
+  CHECK(drive.Holding());
+  drive.TurnBy(0.25f);
+  drive.TurnBy(0.25f);
+  delay(30);
+  drive.Telemetry(t);
+  CHECKF(fabsf(t.target - 1.5f) < 1e-5f, "target %.4f", t.target);
+  CHECK(t.holding && !t.stopped);
+
+  drive.Stop(true);
+  CHECK(drive.Stopped() && !drive.Holding());
+  delay(30);
+  CHECK(braked());
+  CHECK(drive.LeftPct() == 0.0f && drive.RightPct() == 0.0f);
+
+  // Stop then TurnBy: released first, so the turn starts from the measured heading
+  g_yaw = -0.5f;
+  drive.Stop();
+  drive.TurnBy(0.25f);
+  delay(30);
+  drive.Telemetry(t);
+  CHECKF(fabsf(t.target + 0.25f) < 1e-5f, "target %.4f", t.target);
+  CHECK(t.holding && !t.stopped);
+}
+
+// Commands and reads as fast as the sketch can issue them, then a brake that has to hold
+static void testHammer(LokaDrive& drive) {
+  uint32_t x = 12345;
+  const uint32_t end = millis() + 500;
+  while ((int32_t)(millis() - end) < 0) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    switch (x % 6) {
+      case 0: drive.Drive((x % 100) * 0.003f, ((x >> 8) % 100) * 0.02f - 1.0f); break;
+      case 1: drive.Stop(x & 0x100); break;
+      case 2: drive.HoldHeading(((x >> 8) % 628) * 0.01f); break;
+      case 3: drive.TurnBy(0.1f); break;
+      case 4: drive.Release(); break;
+      default: {
+        LokaDriveTelemetry t;
+        drive.Telemetry(t);
+        (void)drive.Saturated(); (void)drive.Holding(); (void)drive.LeftPct();
+      }
+    }
+    g_yaw = ((x >> 4) % 628) * 0.01f - 3.14f;
+    if ((x & 0xf) == 0) delayMicroseconds(200);
+  }
+
+  drive.Stop(true);
+  delay(20);
+  uint32_t moved = 0;
+  for (int i = 0; i < 100; i++) {
+    if (!braked()) moved++;
+    delay(1);
+  }
+  CHECKF(moved == 0, "%u of 100 samples off the brake", moved);
+}
+
+int main() {
+  hostRealTime(true);
+  LokaMotor l(kL1, kL2), r(kR1, kR2);
+  LokaDrive drive(l, r);
+  drive.Init();
+  l.Deadband(10.0f);
+  r.Deadband(10.0f);
+  drive.GyroHook(gyroZ);
+  drive.HeadingHook(heading);
+  CHECK(drive.StartTask(200));
+  CHECK(drive.TaskRunning());
+
+  testCommands(drive);
+  testHammer(drive);
+
+  drive.StopTask();
+  CHECK(!drive.TaskRunning());
+  drive.Drive(0.1f, 0.0f);  // the caller owns it again: applied right away
+  CHECK(!drive.Stopped());
+  drive.Update();
+  CHECK(drive.LeftPct() > 0.0f);
+  return hostReport("drive_task");
+}
@@ -0,0 +1,291 @@
+// LokaMCU's IMU path against a fake SH-2 hub: the report intervals and batch
+// intervals it configures, and what happens to batched reports on the way out.
+// Reports of different sensors in one packet must come out of ImuRead() in time
+// order; a full queue drops its oldest samples, skipped sequence numbers are
+// counted, the poll budget stops a drain early, and a hub reset brings the
+// configuration back without counting the restarted numbering as a gap. The
+// light sensor's INT events run through a fake VCNL4040 alongside.
+#include <algorithm>
+#include "host.h"
+#include "fake_sh2.h"
+#include "fake_vcnl4040.h"
+#include "LokaMCU.h"
+
+static FakeSH2 hub;
+static FakeVCNL4040 als;
+static LokaMCU mcu;
+static uint8_t seqNext[256];  // next sequence number per report id
+
+static FakeSH2::Record rec(uint8_t id, uint16_t delay, int16_t v0 = 0) {
+  FakeSH2::Record r = {id, seqNext[id]++, delay, {v0, 0, 0, 0}};
+  if (id == SH2_GAME_ROTATION_VECTOR) r.v[3] = 16384;  // identity, Q14
+  return r;
+}
+
+// n gyro reports 1 ms apart, values first..first+n-1
+static void gyroBatch(size_t n, int16_t first = 0) {
+  FakeSH2::Record r[30];
+  for (size_t i = 0; i < n; i++) r[i] = rec(SH2_GYROSCOPE_CALIBRATED, (uint16_t)(10 * i), (int16_t)(first + i));
+  hub.batch(r, n, 10 * n);
+}
+
+static void drain() {
+  LokaImuSample s;
+  while (mcu.ImuRead(s)) {}
+}
+
+static void testInit() {
+  CHECK(hub.resets == 1);
+  const FakeSH2::Feature* f = hub.feature;
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].sets == 1 && f[SH2_GAME_ROTATION_VECTOR].intervalUs == 100000);
+  CHECK(f[SH2_GYROSCOPE_CALIBRATED].sets == 1 && f[SH2_GYROSCOPE_CALIBRATED].intervalUs == 100000);
+  CHECK(f[SH2_ACCELEROMETER].sets == 1 && f[SH2_ACCELEROMETER].intervalUs == 1000000 / LOKA_IMU_TAP_HZ);
+  CHECK(f[SH2_TAP_DETECTOR].sets == 1);
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].batchUs == 0 && f[SH2_GYROSCOPE_CALIBRATED].batchUs == 0);
+}
+
+// Reports follow Run(hz), the accelerometer keeps its floor, ImuRate() pins one sensor and
+// unchanged intervals are not sent again
+static void testRates() {
+  const FakeSH2::Feature* f = hub.feature;
+  const uint32_t accSets = f[SH2_ACCELEROMETER].sets;
+  mcu.Run(50);
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].intervalUs == 20000 && f[SH2_GYROSCOPE_CALIBRATED].intervalUs == 20000);
+  CHECK(f[SH2_ACCELEROMETER].sets == accSets);
+
+  mcu.ImuRate(GYR, 200);
+  CHECK(f[SH2_GYROSCOPE_CALIBRATED].intervalUs == 5000);
+  const uint32_t rotSets = f[SH2_GAME_ROTATION_VECTOR].sets;
+  const uint32_t gyrSets = f[SH2_GYROSCOPE_CALIBRATED].sets;
+  mcu.Run(20);
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].intervalUs == 50000 && f[SH2_GYROSCOPE_CALIBRATED].sets == gyrSets);
+  mcu.Run(20);
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].sets == rotSets + 1);
+
+  mcu.ImuRate(GYR, 0);
+  CHECK(f[SH2_GYROSCOPE_CALIBRATED].intervalUs == 50000);
+  mcu.ImuRate(TAP, 400);
+  CHECK(f[SH2_ACCELEROMETER].intervalUs == 2500);
+  mcu.ImuRate(TAP, 0);
+  CHECK(f[SH2_ACCELEROMETER].intervalUs == 1000000 / LOKA_IMU_TAP_HZ);
+  CHECK(f[SH2_ACCELEROMETER].sets == accSets + 2);
+}
+
+// Batch() resends every report with the batch interval of its feature; the tap detector
+// itself is never batched
+static void testBatch() {
+  const FakeSH2::Feature* f = hub.feature;
+  const uint32_t tapSets = f[SH2_TAP_DETECTOR].sets;
+  mcu.Batch(40);
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].batchUs == 40000);
+  CHECK(f[SH2_GYROSCOPE_CALIBRATED].batchUs == 40000);
+  CHECK(f[SH2_ACCELEROMETER].batchUs == 40000);
+  CHECK(f[SH2_TAP_DETECTOR].batchUs == 0 && f[SH2_TAP_DETECTOR].sets == tapSets + 1);
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].intervalUs == 50000);
+
+  mcu.Batch(25, GYR);
+  CHECK(f[SH2_GAME_ROTATION_VECTOR].batchUs == 0);
+  CHECK(f[SH2_GYROSCOPE_CALIBRATED].batchUs == 25000);
+  CHECK(f[SH2_ACCELEROMETER].batchUs == 0);
+  CHECK(f[SH2_GYROSCOPE_CALIBRATED].intervalUs == 50000);
+
+  mcu.Batch(0);
+  CHECK(f[SH2_GYROSCOPE_CALIBRATED].batchUs == 0);
+}
+
+// One packet holds each sensor's reports in a run of their own; ImuRead() merges them by
+// sample time, which the hub gives as delays after the packet's base reference
+static void testOrdering() {
+  mcu.ImuClearStats();
+  mcu.PollBudget(0);
+  FakeSH2::Record r[24];
+  size_t n = 0;
+  for (int i = 0; i < 10; i++) r[n++] = rec(SH2_GYROSCOPE_CALIBRATED, (uint16_t)(20 * i + 10), (int16_t)(512 * i));
+  for (int i = 0; i < 4; i++)  r[n++] = rec(SH2_GAME_ROTATION_VECTOR, (uint16_t)(50 * i + 15));
+  for (int i = 0; i < 10; i++) r[n++] = rec(SH2_ACCELEROMETER, (uint16_t)(20 * i), 256 * 10);
+  hub.batch(r, n, 300);
+  mcu.ImuService();
+  CHECK(mcu.ImuAvailable() == n);
+  CHECK(mcu.ImuAvailable(IMU_GYR) == 10 && mcu.ImuAvailable(IMU_ROT) == 4 && mcu.ImuAvailable(IMU_ACC) == 10);
+
+  FakeSH2::Record want[24];
+  std::copy(r, r + n, want);
+  std::stable_sort(want, want + n, [](const FakeSH2::Record& a, const FakeSH2::Record& b) { return a.delay < b.delay; });
+  LokaImuSample s, first = {};
+  uint32_t bad = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (!mcu.ImuRead(s)) { bad++; break; }
+    if (!i) first = s;
+    const bool ok = s.id == want[i].id && s.us - first.us == (uint64_t)(want[i].delay - want[0].delay) * 100;
+    if (!ok && bad++ < 3) fprintf(stderr, "sample %zu: id 0x%02x at +%llu us, want 0x%02x at +%u us\n", i, s.id,
+                                  (unsigned long long)(s.us - first.us), want[i].id, (want[i].delay - want[0].delay) * 100);
+  }
+  CHECKF(bad == 0, "%u samples out of order", bad);
+  CHECK(!mcu.ImuRead(s));
+  CHECK(first.us + 30000 < mcu.NowUs());  // the base reference lies 30 ms before the packet
+
+  // values survive the trip: gyro i reads i rad/s
+  gyroBatch(3, 512);
+  mcu.ImuService();
+  CHECK(mcu.ImuRead(IMU_GYR, s) && s.v[0] == 1.0f && s.id == SH2_GYROSCOPE_CALIBRATED);
+  drain();
+  const LokaImuStats& st = mcu.ImuStats();
+  CHECK(st.overruns == 0 && st.seqGaps == 0 && st.hubOverruns == 0 && st.budgetHits == 0);
+  CHECK(st.packets == 2 && st.maxBacklog == 10 && st.backlog == 0);
+}
+
+// Sixty samples into a queue of LOKA_IMU_QUEUE: the oldest are pushed out and counted
+static void testOverrun() {
+  mcu.ImuClearStats();
+  gyroBatch(30, 0);
+  gyroBatch(30, 30);
+  mcu.ImuService();
+  const LokaImuStats& st = mcu.ImuStats();
+  CHECK(st.overruns == 60 - LOKA_IMU_QUEUE);
+  CHECK(st.maxBacklog == LOKA_IMU_QUEUE && st.backlog == LOKA_IMU_QUEUE);
+  CHECK(st.seqGaps == 0 && st.hubOverruns == 0);
+  LokaImuSample s;
+  CHECK(mcu.ImuRead(IMU_GYR, s) && s.v[0] == (60 - LOKA_IMU_QUEUE) / 512.0f);
+  CHECK(mcu.ImuLatest(IMU_GYR, s) && s.v[0] == 59 / 512.0f);
+  CHECK(mcu.ImuAvailable() == 0);
+  CHECK(mcu.ImuDropped() == 60 - LOKA_IMU_QUEUE);
+}
+
+// Numbers the hub skipped count per sensor, the wrap from 255 to 0 does not
+static void testSeqGaps() {
+  seqNext[SH2_GYROSCOPE_CALIBRATED] = 250;  // near the wrap, the jump there is not counted
+  gyroBatch(1);
+  mcu.ImuService();
+  drain();
+  mcu.ImuClearStats();
+  gyroBatch(3);
+  seqNext[SH2_GYROSCOPE_CALIBRATED] += 3;
+  gyroBatch(10);  // runs over the wrap
+  FakeSH2::Record r[2];
+  r[0] = rec(SH2_GAME_ROTATION_VECTOR, 0);
+  seqNext[SH2_GAME_ROTATION_VECTOR] += 2;
+  r[1] = rec(SH2_GAME_ROTATION_VECTOR, 10);
+  hub.batch(r, 2, 10);
+  mcu.ImuService();
+  drain();
+  CHECK(mcu.ImuStats().seqGaps == 5);
+  CHECK(mcu.ImuDropped() == 5);
+}
+
+// A budget smaller than one packet's transfer stops the drain after that packet; the rest
+// waits for the next poll
+static void testBudget() {
+  mcu.ImuClearStats();
+  mcu.PollBudget(1);
+  for (int i = 0; i < 3; i++) gyroBatch(10);
+  mcu.ImuService();
+  CHECK(mcu.ImuStats().budgetHits == 1 && mcu.ImuStats().packets == 1);
+  CHECK(mcu.ImuAvailable(IMU_GYR) == 10 && hub.pending());
+  mcu.ImuService();
+  CHECK(mcu.ImuStats().budgetHits == 2 && mcu.ImuAvailable(IMU_GYR) == 20);
+
+  mcu.PollBudget(0);
+  for (int i = 0; i < 3; i++) gyroBatch(10);
+  mcu.ImuService();
+  CHECK(!hub.pending() && mcu.ImuAvailable(IMU_GYR) == LOKA_IMU_QUEUE);
+  CHECK(mcu.ImuStats().budgetHits == 2 && mcu.ImuStats().packets == 6);
+  CHECK(mcu.ImuStats().seqGaps == 0);
+  drain();
+  mcu.PollBudget(2000);
+}
+
+// After a hub reset every report is configured again, batching included, and the hub's
+// numbering starting over is not a gap
+static void testReset() {
+  mcu.ImuClearStats();
+  mcu.Batch(40);
+  FakeSH2::Feature before[256];
+  std::copy(hub.feature, hub.feature + 256, before);
+  hub.reset();
+  mcu.ImuService();  // takes the reset-complete
+  mcu.ImuService();
+  static const uint8_t ids[] = {SH2_GAME_ROTATION_VECTOR, SH2_GYROSCOPE_CALIBRATED, SH2_ACCELEROMETER, SH2_TAP_DETECTOR};
+  for (uint8_t id : ids) {
+    CHECKF(hub.feature[id].sets == before[id].sets + 1, "report 0x%02x sent %u times", id, hub.feature[id].sets - before[id].sets);
+    CHECK(hub.feature[id].intervalUs == before[id].intervalUs && hub.feature[id].batchUs == before[id].batchUs);
+  }
+  CHECK(hub.feature[SH2_GYROSCOPE_CALIBRATED].batchUs == 40000);
+
+  for (int i = 0; i < 256; i++) seqNext[i] = 0;
+  gyroBatch(5);
+  mcu.ImuService();
+  CHECK(mcu.ImuAvailable(IMU_GYR) == 5);
+  CHECK(mcu.ImuStats().seqGaps == 0);
+  drain();
+  mcu.Batch(0);
+}
+
+static int nearCalls = 0, darkCalls = 0;
+static bool nearState = false, darkState = false;
+static void onNear(bool near) { nearCalls++; nearState = near; }
+static void onDark(bool dark) { darkCalls++; darkState = dark; }
+
+// With LightInt() the sensor is read only when INT fires or stays low; callbacks run on a
+// state change, the ambient window follows the state and the headlight follows the dark
+static void testLight() {
+  static const uint8_t kInt = 9, kLed = 4;
+  mcu.SetDarkLED(kLed);
+  mcu.LightInt(kInt);
+  mcu.OnNear(200, 100, onNear);
+  mcu.OnDark(20, 40, onDark);
+  CHECK(als.reg[VCNL4040_PS_THDL] == 100 && als.reg[VCNL4040_PS_THDH] == 200);
+  CHECK(als.reg[VCNL4040_ALS_THDL] == 20 && als.reg[VCNL4040_ALS_THDH] == 0xFFFF);
+
+  const uint32_t reads = als.reads;
+  for (int i = 0; i < 5; i++) mcu.Run(20);
+  CHECK(als.reads == reads);  // INT idle: no polling
+
+  als.reg[VCNL4040_PROX] = 300;
+  als.reg[VCNL4040_INT_FLAG] = VCNL4040_INT_PS_CLOSE << 8;
+  hostFireInterrupt(kInt);
+  mcu.Run(20);
+  CHECK(nearCalls == 1 && nearState && mcu.Near() && mcu.LightProximity() == 300);
+  CHECK(als.reg[VCNL4040_INT_FLAG] == 0);
+  mcu.Run(20);
+  CHECK(nearCalls == 1);
+
+  als.reg[VCNL4040_AMBIENT] = 10;
+  als.reg[VCNL4040_INT_FLAG] = VCNL4040_INT_ALS_LOW << 8;
+  hostSetPin(kInt, LOW);  // edge missed, the line is still low
+  mcu.Run(20);
+  hostSetPin(kInt, HIGH);
+  CHECK(darkCalls == 1 && darkState && mcu.Dark());
+  CHECK(als.reg[VCNL4040_ALS_THDL] == 0 && als.reg[VCNL4040_ALS_THDH] == 40);
+  CHECK(hostPinLevel(kLed) == HIGH);
+
+  // both crossings latched between reads: the reading decides
+  als.reg[VCNL4040_PROX] = 50;
+  als.reg[VCNL4040_INT_FLAG] = (VCNL4040_INT_PS_CLOSE | VCNL4040_INT_PS_AWAY) << 8;
+  hostFireInterrupt(kInt);
+  mcu.Run(20);
+  CHECK(nearCalls == 2 && !nearState && !mcu.Near());
+
+  als.reg[VCNL4040_AMBIENT] = 60;
+  als.reg[VCNL4040_INT_FLAG] = VCNL4040_INT_ALS_HIGH << 8;
+  hostFireInterrupt(kInt);
+  mcu.Run(20);
+  CHECK(darkCalls == 2 && !darkState && !mcu.Dark());
+  CHECK(als.reg[VCNL4040_ALS_THDL] == 20 && als.reg[VCNL4040_ALS_THDH] == 0xFFFF);
+  CHECK(hostPinLevel(kLed) == LOW);
+}
+
+int main() {
+  Wire.attach(0x4A, &hub);
+  Wire.attach(VCNL4040_I2C_ADDR, &als);
+  mcu.Init(ROT | GYR | TAP | LIGHT);
+  testInit();
+  testRates();
+  testBatch();
+  testOrdering();
+  testOverrun();
+  testSeqGaps();
+  testBudget();
+  testReset();
+  testLight();
+  return hostReport("lokamcu");
+}
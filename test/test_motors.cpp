@@ -0,0 +1,95 @@
+// LokaMotor on the virtual clock, read back from the PWM duty: a stop has to
+// outlast the Update() calls the header asks for, and the slew limit has to
+// hold however long the output sat still before a new target.
+#include "host.h"
+#include "LokaMotors.h"
+
+static const uint8_t kIn1 = 1, kIn2 = 2;
+static const uint32_t kMaxDuty = (1u << LOKA_PWM_RES_BITS) - 1;
+
+static bool pins(uint32_t in1, uint32_t in2) { return hostPinDuty(kIn1) == in1 && hostPinDuty(kIn2) == in2; }
+
+// Brake() and Coast() hold through Update() and Ctrl(0), in either decay mode and with a slew
+// limit, until a nonzero Ctrl() or the other stop
+static void testStopHolds() {
+  static const LokaMotorMode modes[] = {MOTOR_COAST, MOTOR_BRAKE};
+  for (LokaMotorMode mode : modes) {
+    for (float slew : {0.0f, 200.0f}) {
+      LokaMotor m(kIn1, kIn2);
+      CHECK(m.Init());
+      m.Mode(mode);
+      m.Slew(slew);
+      m.Ctrl(50.0f);
+      for (int i = 0; i < 400; i++) { delay(5); m.Update(); }
+      CHECK(m.Output() == 50.0f);
+
+      m.Brake();
+      CHECK(m.Stopped());
+      uint32_t moved = 0;
+      for (int i = 0; i < 50; i++) {
+        delay(5);
+        if (i == 10) m.Ctrl(0.0f);
+        m.Update();
+        if (!pins(kMaxDuty, kMaxDuty)) moved++;
+      }
+      CHECKF(moved == 0, "mode %u slew %.0f: %u of 50 updates left the brake", mode, slew, moved);
+
+      m.Coast();
+      for (int i = 0; i < 50; i++) { delay(5); m.Update(); if (!pins(0, 0)) moved++; }
+      CHECKF(moved == 0, "mode %u slew %.0f: %u of 50 updates left the coast", mode, slew, moved);
+
+      m.Ctrl(-20.0f);
+      CHECK(!m.Stopped());
+      for (int i = 0; i < 400; i++) { delay(5); m.Update(); }
+      CHECK(m.Output() == -20.0f);
+    }
+  }
+}
+
+// Max step per Update() at 200 Hz and 200 %/s
+static const float kStep = 200.0f * 0.005f;
+
+// The output moves by at most one period of slew per Update(), also on the first call after Init()
+// and after a second in which nobody called Update()
+static void testSlewAfterPause() {
+  LokaMotor m(kIn1, kIn2);
+  CHECK(m.Init());
+  m.Slew(200.0f);
+  delay(1000);
+  m.Ctrl(100.0f);
+  m.Update();
+  CHECKF(m.Output() <= kStep + 1e-4f, "first Update() after Init() went to %.2f%%", m.Output());
+  delay(1000);  // and a second one before any period was seen
+  m.Update();
+  CHECKF(m.Output() <= kStep + 1e-4f, "second Update() after Init() went to %.2f%%", m.Output());
+  for (int i = 0; i < 20; i++) { delay(5); m.Update(); }
+  CHECKF(m.Output() <= 21.0f * kStep + 1e-3f, "ramp at %.2f%% after 21 updates", m.Output());
+
+  m.Ctrl(0.0f);
+  for (int i = 0; i < 100; i++) { delay(5); m.Update(); }
+  CHECK(m.Output() == 0.0f);
+
+  delay(1000);  // settled and left alone, as LokaDrive leaves its motors while stopped
+  m.Ctrl(100.0f);
+  m.Update();
+  CHECKF(m.Output() <= kStep + 1e-4f, "first Update() after a pause went to %.2f%%", m.Output());
+  for (int i = 0; i < 10; i++) {
+    const float before = m.Output();
+    delay(5);
+    m.Update();
+    CHECKF(m.Output() - before <= kStep + 1e-4f && m.Output() - before >= kStep - 1e-4f,
+           "step %d moved %.3f%%", i, m.Output() - before);
+  }
+
+  m.Brake();
+  delay(1000);
+  m.Ctrl(-100.0f);
+  m.Update();
+  CHECKF(m.Output() >= -kStep - 1e-4f, "first Update() after a brake went to %.2f%%", m.Output());
+}
+
+int main() {
+  testStopHolds();
+  testSlewAfterPause();
+  return hostReport("motors");
+}
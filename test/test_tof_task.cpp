@@ -0,0 +1,84 @@
+// LokaToF's triple buffer under a real reader and writer: the task decodes
+// frames on its own thread while loop() reads Frame() as fast as it can. The
+// fake part reports one distance in every zone of a frame, rising frame by
+// frame, so a torn frame shows up as zones that disagree or as a distance that
+// does not match its sequence number. Built with ThreadSanitizer.
+#include <atomic>
+#include <thread>
+#include "host.h"
+#include "fake_vl53l5cx.h"
+#include "LokaToF.h"
+
+static const uint8_t kIntPin = 4;
+
+struct ReadStats {
+  uint32_t reads;
+  uint32_t frames;     // distinct sequence numbers seen
+  uint32_t torn;
+  uint32_t backwards;
+};
+
+// Reads Frame() for ms of wall time
+static ReadStats hammer(LokaToF& tof, uint32_t ms) {
+  ReadStats s = {};
+  uint32_t lastSeq = 0;
+  int16_t lastMm = 0;
+  const uint64_t end = hostMicros64() + ms * 1000ull;
+  while (hostMicros64() < end) {
+    const LokaToFFrame& f = tof.Frame();
+    s.reads++;
+    if (f.seq == 0) continue;  // nothing decoded yet
+    bool whole = f.zones == 16;
+    for (uint8_t i = 1; i < f.zones && whole; i++) whole = f.dist[i] == f.dist[0];
+    if (!whole) s.torn++;
+    if (f.seq < lastSeq || (f.seq == lastSeq && f.dist[0] != lastMm) || (f.seq > lastSeq && f.dist[0] < lastMm)) s.backwards++;
+    if (f.seq != lastSeq) s.frames++;
+    lastSeq = f.seq;
+    lastMm = f.dist[0];
+  }
+  return s;
+}
+
+static void checkRun(const char* mode, const ReadStats& s, uint32_t minFrames) {
+  CHECKF(s.frames >= minFrames, "%s: %u frames in %u reads", mode, s.frames, s.reads);
+  CHECKF(s.torn == 0, "%s: %u torn reads", mode, s.torn);
+  CHECKF(s.backwards == 0, "%s: %u reads out of order", mode, s.backwards);
+}
+
+static void testPolling(LokaToF& tof) {
+  CHECK(tof.StartTask());
+  tof.Run(60);
+  const ReadStats s = hammer(tof, 1500);
+  tof.StopTask();
+  CHECK(!tof.TaskRunning());
+  checkRun("polling", s, 40);
+}
+
+// Edges arrive faster than frames, from another thread like an ISR on the other core
+static void testInt(LokaToF& tof) {
+  tof.UseInt(kIntPin);
+  std::atomic<bool> stop(false);
+  std::thread edges([&stop] {
+    while (!stop) { hostFireInterrupt(kIntPin); delayMicroseconds(700); }
+  });
+  CHECK(tof.StartTask());
+  const ReadStats s = hammer(tof, 1500);
+  tof.StopTask();
+  stop = true;
+  edges.join();
+  CHECK(!tof.TaskRunning());
+  tof.UsePolling();
+  checkRun("INT", s, 40);
+}
+
+int main() {
+  FakeVL53L5CX dev;
+  Wire.attach(0x29, &dev);
+
+  LokaToF tof;
+  CHECK(tof.Init(Z16));  // on the virtual clock, the upload takes no wall time
+  hostRealTime(true);
+  testPolling(tof);
+  testInt(tof);
+  return hostReport("tof_task");
+}
@@ -0,0 +1,156 @@
+// VCNL4040 options against a fake register map: every typed setting must land
+// in the bits the datasheet gives it, in the right command code and byte, and
+// leave the rest alone. Expected values are spelled out from the datasheet
+// tables here rather than taken from the driver's own masks.
+#include "host.h"
+#include "VCNL4040.h"
+#include "fake_vcnl4040.h"
+
+static uint16_t bits(uint16_t v, int hi, int lo) { return (uint16_t)((v >> lo) & ((1u << (hi - lo + 1)) - 1)); }
+
+static void testBegin() {
+  FakeVCNL4040 dev;
+  Wire.attach(0x60, &dev);
+  VCNL4040 als;
+  CHECK(als.begin(Wire, VCNL4040_CH_PROX | VCNL4040_CH_AMBIENT));
+  CHECK(bits(dev.reg[0x00], 0, 0) == 0);   // ALS_SD: on
+  CHECK(bits(dev.reg[0x03], 0, 0) == 0);   // PS_SD: on
+  CHECK(bits(dev.reg[0x04], 15, 15) == 1); // WHITE_EN: 1 = off
+  CHECK(bits(dev.reg[0x03], 11, 11) == 1); // PS_HD: 16-bit
+
+  CHECK(als.setChannels(VCNL4040_CH_WHITE));
+  CHECK(bits(dev.reg[0x00], 0, 0) == 1);
+  CHECK(bits(dev.reg[0x03], 0, 0) == 1);
+  CHECK(bits(dev.reg[0x04], 15, 15) == 0);
+  Wire.detach(0x60);
+
+  FakeVCNL4040 other;
+  other.reg[0x0C] = 0x0180;
+  Wire.attach(0x60, &other);
+  CHECK(!als.begin(Wire));
+  CHECK(other.writes == 0);
+  Wire.detach(0x60);
+}
+
+static void testFields() {
+  FakeVCNL4040 dev;
+  Wire.attach(0x60, &dev);
+  VCNL4040 als;
+  CHECK(als.begin(Wire));
+  const uint16_t als0 = dev.reg[0x00], ps0 = dev.reg[0x03], ms0 = dev.reg[0x04];
+
+  // ALS_CONF: ALS_IT 7:6
+  for (uint8_t it = 0; it < 4; it++) {
+    CHECK(als.setAmbientIntegrationTime((VCNL4040_AlsIt)it));
+    CHECKF(bits(dev.reg[0x00], 7, 6) == it, "ALS_IT %u: 0x%04x", it, dev.reg[0x00]);
+  }
+  // PS_CONF1: PS_IT 3:1, PS_Duty 7:6
+  for (uint8_t it = 0; it < 8; it++) {
+    CHECK(als.setProxIntegrationTime((VCNL4040_PsIt)it));
+    CHECKF(bits(dev.reg[0x03], 3, 1) == it, "PS_IT %u: 0x%04x", it, dev.reg[0x03]);
+  }
+  for (uint8_t duty = 0; duty < 4; duty++) {
+    CHECK(als.setProxDutyCycle((VCNL4040_PsDuty)duty));
+    CHECKF(bits(dev.reg[0x03], 7, 6) == duty, "PS_Duty %u: 0x%04x", duty, dev.reg[0x03]);
+  }
+  // PS_MS: LED_I 10:8
+  for (uint8_t led = 0; led < 8; led++) {
+    CHECK(als.setLedCurrent((VCNL4040_LedCurrent)led));
+    CHECKF(bits(dev.reg[0x04], 10, 8) == led, "LED_I %u: 0x%04x", led, dev.reg[0x04]);
+  }
+  // PS_CONF2: PS_HD 11
+  CHECK(als.setProxHighResolution(false));
+  CHECK(bits(dev.reg[0x03], 11, 11) == 0);
+  CHECK(als.setProxHighResolution(true));
+  CHECK(bits(dev.reg[0x03], 11, 11) == 1);
+
+  // Back to where each field started: nothing else may have moved
+  CHECK(als.setAmbientIntegrationTime((VCNL4040_AlsIt)bits(als0, 7, 6)));
+  CHECK(als.setProxIntegrationTime((VCNL4040_PsIt)bits(ps0, 3, 1)));
+  CHECK(als.setProxDutyCycle((VCNL4040_PsDuty)bits(ps0, 7, 6)));
+  CHECK(als.setLedCurrent((VCNL4040_LedCurrent)bits(ms0, 10, 8)));
+  CHECKF(dev.reg[0x00] == als0, "ALS_CONF 0x%04x, was 0x%04x", dev.reg[0x00], als0);
+  CHECKF(dev.reg[0x03] == ps0, "PS_CONF1_2 0x%04x, was 0x%04x", dev.reg[0x03], ps0);
+  CHECKF(dev.reg[0x04] == ms0, "PS_CONF3_MS 0x%04x, was 0x%04x", dev.reg[0x04], ms0);
+  Wire.detach(0x60);
+}
+
+static void testInterrupts() {
+  FakeVCNL4040 dev;
+  Wire.attach(0x60, &dev);
+  VCNL4040 als;
+  CHECK(als.begin(Wire));
+
+  // PS_INT 9:8, and PS_MS 14 cleared so INT reports through INT_FLAG
+  static const uint8_t modes[] = {VCNL4040_PS_INT_CLOSE, VCNL4040_PS_INT_AWAY, VCNL4040_PS_INT_BOTH, VCNL4040_PS_INT_OFF};
+  for (uint8_t m : modes) {
+    CHECK(als.setProxInterrupt((VCNL4040_PsInt)m));
+    CHECKF(bits(dev.reg[0x03], 9, 8) == m, "PS_INT %u: 0x%04x", m, dev.reg[0x03]);
+    CHECK(bits(dev.reg[0x04], 14, 14) == 0);
+  }
+  // ALS_CONF: ALS_INT_EN 1
+  CHECK(als.setAmbientInterrupt(true));
+  CHECK(bits(dev.reg[0x00], 1, 1) == 1);
+  CHECK(als.setAmbientInterrupt(false));
+  CHECK(bits(dev.reg[0x00], 1, 1) == 0);
+
+  // PS_PERS 5:4 counts 1..4, ALS_PERS 3:2 counts 1, 2, 4, 8
+  static const uint8_t psCount[] = {1, 2, 3, 4}, alsCount[] = {1, 2, 4, 8};
+  for (uint8_t i = 0; i < 4; i++) {
+    CHECK(als.setPersistence(psCount[i], alsCount[i]));
+    CHECKF(bits(dev.reg[0x03], 5, 4) == i, "PS_PERS %u: 0x%04x", psCount[i], dev.reg[0x03]);
+    CHECKF(bits(dev.reg[0x00], 3, 2) == i, "ALS_PERS %u: 0x%04x", alsCount[i], dev.reg[0x00]);
+  }
+
+  // Thresholds: PS_THDL 0x06, PS_THDH 0x07, ALS_THDH 0x01, ALS_THDL 0x02, whole 16 bits
+  CHECK(als.setProxThresholds(0x1234, 0xABCD));
+  CHECK(dev.reg[0x06] == 0x1234 && dev.reg[0x07] == 0xABCD);
+  CHECK(als.setAmbientThresholds(0x0102, 0xF0E0));
+  CHECK(dev.reg[0x02] == 0x0102 && dev.reg[0x01] == 0xF0E0);
+
+  // INT_FLAG: flags in the high byte, cleared by the read
+  uint8_t flags = 0xff;
+  dev.reg[0x0B] = (uint16_t)((VCNL4040_INT_PS_CLOSE | VCNL4040_INT_ALS_HIGH) << 8);
+  CHECK(als.readInterruptFlags(flags));
+  CHECK(flags == 0x12);
+  CHECK(als.readInterruptFlags(flags));
+  CHECK(flags == 0);
+  Wire.detach(0x60);
+}
+
+static void testRead() {
+  FakeVCNL4040 dev;
+  Wire.attach(0x60, &dev);
+  VCNL4040 als;
+  CHECK(als.begin(Wire, VCNL4040_CH_AMBIENT));
+  dev.reg[0x08] = 321;
+  dev.reg[0x09] = 1000;
+  dev.reg[0x0A] = 777;
+
+  dev.reads = 0;
+  CHECK(als.read());
+  CHECK(dev.reads == 1);  // disabled channels cost no transaction
+  CHECK(als.getAmbient() == 1000 && als.getProximity() == 0 && als.getWhite() == 0);
+
+  // 0.1 lux per count at 80 ms, halved with every doubling of ALS_IT
+  static const float lux[] = {100.0f, 50.0f, 25.0f, 12.5f};
+  for (uint8_t it = 0; it < 4; it++) {
+    CHECK(als.setAmbientIntegrationTime((VCNL4040_AlsIt)it));
+    CHECKF(fabsf(als.getLux() - lux[it]) < 0.01f, "ALS_IT %u: %.3f lux", it, als.getLux());
+  }
+
+  CHECK(als.setChannels(VCNL4040_CH_ALL));
+  dev.reads = 0;
+  CHECK(als.read());
+  CHECK(dev.reads == 3);
+  CHECK(als.getProximity() == 321 && als.getAmbient() == 1000 && als.getWhite() == 777);
+  Wire.detach(0x60);
+}
+
+int main() {
+  testBegin();
+  testFields();
+  testInterrupts();
+  testRead();
+  return hostReport("vcnl4040");
+}
@@ -0,0 +1,138 @@
+// vl53l5cx_init_step() driven through beginAsync()/initStep() against the
+// fake part, on the virtual clock: every step stays within its budget plus one
+// unit of work, waits cost no bus time, the decoded firmware arrives intact and
+// a part that stops answering fails the boot instead of hanging it.
+#include "host.h"
+#include "fake_vl53l5cx.h"
+#include "SparkFun_VL53L5CX_Library.h"
+#include "vl53l5cx_buffers.h"
+
+static const uint8_t kAddr = 0x29;
+
+struct InitRun {
+  bool done;
+  bool failed;
+  uint32_t steps;
+  uint32_t idle;        // steps that found nothing to do but wait
+  uint64_t maxStepUs;
+  uint64_t totalUs;
+};
+
+// Boots the fake through initStep(budgetMs), with 1 ms of other loop() work per pass
+static InitRun bootAsync(FakeVL53L5CX& dev, uint32_t budgetMs) {
+  InitRun r = {};
+  SparkFun_VL53L5CX tof;
+  Wire.attach(kAddr, &dev);
+  const uint64_t t0 = hostMicros64();
+  CHECK(tof.beginAsync(kAddr, Wire));
+
+  while (!tof.isInitDone() && hostMicros64() - t0 < 10000000ull) {
+    const uint32_t bytes = Wire.bytes();
+    const uint64_t s = hostMicros64();
+    const bool ok = tof.initStep(budgetMs);
+    const uint64_t d = hostMicros64() - s;
+    r.steps++;
+    if (Wire.bytes() == bytes) r.idle++;
+    if (d > r.maxStepUs) r.maxStepUs = d;
+    if (!ok) { r.failed = true; break; }
+    delay(1);
+  }
+  r.done = tof.isInitDone();
+  r.totalUs = hostMicros64() - t0;
+  Wire.detach(kAddr);
+  return r;
+}
+
+static bool sameFirmware(const FakeVL53L5CX& dev) {
+  return dev.fwBytes == sizeof(VL53L5CX_FIRMWARE) &&
+         memcmp(dev.fw.data(), VL53L5CX_FIRMWARE, sizeof(VL53L5CX_FIRMWARE)) == 0;
+}
+
+// Budget 0 ends every step after exactly one unit, which measures the longest one
+static void testUnitsAreSmall(uint64_t& unitUs) {
+  FakeVL53L5CX dev;
+  const InitRun r = bootAsync(dev, 0);
+  CHECK(r.done && !r.failed);
+  CHECK(sameFirmware(dev));
+  CHECKF(r.steps > sizeof(VL53L5CX_FIRMWARE) / VL53L5CX_INIT_SLICE_SIZE, "%u steps", r.steps);
+  CHECKF(r.maxStepUs < 30000, "longest unit %llu us", (unsigned long long)r.maxStepUs);
+  unitUs = r.maxStepUs;
+}
+
+static void testStepsKeepBudget(uint64_t unitUs) {
+  static const uint32_t budgets[] = {1, 5, 20};
+  for (uint32_t budget : budgets) {
+    FakeVL53L5CX dev;
+    const InitRun r = bootAsync(dev, budget);
+    CHECKF(r.done && !r.failed, "budget %u", budget);
+    CHECK(sameFirmware(dev));
+    CHECKF(r.maxStepUs <= budget * 1000ull + unitUs, "budget %u: step took %llu us", budget,
+           (unsigned long long)r.maxStepUs);
+  }
+}
+
+// The 100 ms reboot wait and the boot poll leave the bus and the loop alone
+static void testWaitsAreFree() {
+  FakeVL53L5CX dev;
+  dev.bootMs = 150;
+  const InitRun r = bootAsync(dev, 5);
+  CHECK(r.done);
+  CHECKF(r.idle >= 90, "%u idle steps", r.idle);
+}
+
+static void testBlockingBeginMatches() {
+  FakeVL53L5CX dev;
+  SparkFun_VL53L5CX tof;
+  Wire.attach(kAddr, &dev);
+  CHECK(tof.begin(kAddr, Wire));
+  CHECK(sameFirmware(dev));
+  CHECK(tof.getUploadBytes() >= sizeof(VL53L5CX_FIRMWARE));
+
+  // DCI writes from temp_buffer itself must reach the part intact
+  CHECK(tof.setResolution(VL53L5CX_RESOLUTION_8X8));
+  CHECK(tof.getResolution() == VL53L5CX_RESOLUTION_8X8);
+  CHECK(tof.setResolution(VL53L5CX_RESOLUTION_4X4));
+  CHECK(tof.getResolution() == VL53L5CX_RESOLUTION_4X4);
+  Wire.detach(kAddr);
+}
+
+// The first command is the NVM read right after the upload; it fails one poll timeout later
+static void testHungPartTimesOut() {
+  FakeVL53L5CX ok;
+  const InitRun good = bootAsync(ok, 5);
+  FakeVL53L5CX dev;
+  dev.hangCommands = true;
+  const InitRun r = bootAsync(dev, 5);
+  CHECK(r.failed && !r.done);
+  CHECKF(r.totalUs > good.totalUs + VL53L5CX_INIT_POLL_TIMEOUT_MS * 1000ull - 100000ull &&
+         r.totalUs < good.totalUs + VL53L5CX_INIT_POLL_TIMEOUT_MS * 1000ull + 100000ull,
+         "failed after %llu us, boot takes %llu us", (unsigned long long)r.totalUs, (unsigned long long)good.totalUs);
+}
+
+static void testMcuErrorFails() {
+  FakeVL53L5CX dev;
+  dev.mcuError = true;
+  const InitRun r = bootAsync(dev, 5);
+  CHECK(r.failed && !r.done);
+}
+
+static void testNackMidFirmwareFails() {
+  FakeVL53L5CX dev;
+  dev.nackAfter = 200;
+  const InitRun r = bootAsync(dev, 5);
+  CHECK(r.failed && !r.done);
+  CHECK(dev.fwBytes < sizeof(VL53L5CX_FIRMWARE));
+}
+
+int main() {
+  Wire.setClock(400000);
+  uint64_t unitUs = 0;
+  testUnitsAreSmall(unitUs);
+  testStepsKeepBudget(unitUs);
+  testWaitsAreFree();
+  testBlockingBeginMatches();
+  testHungPartTimesOut();
+  testMcuErrorFails();
+  testNackMidFirmwareFails();
+  return hostReport("vl53l5cx_init");
+}
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""
+Loka tools — VL53L5CX firmware compressor
+-----------------------------------------
+Reads VL53L5CX_FIRMWARE from src/tof/vl53l5cx_buffers.h and writes
+src/tof/vl53l5cx_buffers_lz.h, an LZSS image decoded on the fly by
+vl53l5cx_lz.cpp during vl53l5cx_init().
+
+Stream format (must match vl53l5cx_lz.cpp)
+  • A flag byte precedes every group of 8 tokens, LSB first.
+  • Flag bit 1: one literal byte follows.
+  • Flag bit 0: a 2-byte match follows:
+        b0 = (offset - 1) & 0xFF
+        b1 = ((offset - 1) >> 8) << 4 | (length - 3)
+    offset 1..4096 bytes back, length 3..18 bytes.
+
+The encoder decodes its own output before writing the header and aborts
+if the round trip does not reproduce the firmware byte for byte.
+
+Usage
+  python3 tools/vl53l5cx_lz.py            # regenerate the header
+  python3 tools/vl53l5cx_lz.py --check    # round trip only, write nothing
+"""
+
+import os
+import re
+import sys
+
+WINDOW = 4096
+MIN_MATCH = 3
+MAX_MATCH = 18
+MAX_CHAIN = 256
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SRC = os.path.join(ROOT, "src", "tof", "vl53l5cx_buffers.h")
+DST = os.path.join(ROOT, "src", "tof", "vl53l5cx_buffers_lz.h")
+
+
+def read_array(text, name):
+    start = text.index(name + "[]")
+    body = text[text.index("{", start):text.index("}", start)]
+    return bytes(int(v, 16) for v in re.findall(r"0x[0-9a-fA-F]+", body))
+
+
+def find_match(data, pos, chains):
+    best_len, best_off = 0, 0
+    if pos + MIN_MATCH > len(data):
+        return best_len, best_off
+    limit = min(MAX_MATCH, len(data) - pos)
+    cand = chains.get(data[pos:pos + MIN_MATCH], [])
+    for p in reversed(cand[-MAX_CHAIN:]):
+        off = pos - p
+        if off > WINDOW:
+            break
+        n = 0
+        while n < limit and data[p + n] == data[pos + n]:
+            n += 1
+        if n > best_len:
+            best_len, best_off = n, off
+            if n == limit:
+                break
+    return best_len, best_off
+
+
+def compress(data):
+    chains = {}
+    tokens = []
+    pos = 0
+
+    def index(upto):
+        nonlocal indexed
+        while indexed < upto:
+            if indexed + MIN_MATCH <= len(data):
+                chains.setdefault(data[indexed:indexed + MIN_MATCH], []).append(indexed)
+            indexed += 1
+
+    indexed = 0
+    while pos < len(data):
+        index(pos)
+        length, off = find_match(data, pos, chains)
+        if length >= MIN_MATCH:
+            # Lazy evaluation: prefer a literal if the next position matches longer
+            index(pos + 1)
+            nlen, _ = find_match(data, pos + 1, chains)
+            if nlen > length:
+                tokens.append(data[pos])
+                pos += 1
+                continue
+            tokens.append((off, length))
+            pos += length
+        else:
+            tokens.append(data[pos])
+            pos += 1
+
+    out = bytearray()
+    for g in range(0, len(tokens), 8):
+        group = tokens[g:g + 8]
+        flags = 0
+        body = bytearray()
+        for bit, tok in enumerate(group):
+            if isinstance(tok, int):
+                flags |= 1 << bit
+                body.append(tok)
+            else:
+                off, length = tok
+                body.append((off - 1) & 0xFF)
+                body.append((((off - 1) >> 8) << 4) | (length - MIN_MATCH))
+        out.append(flags)
+        out += body
+    return bytes(out)
+
+
+def decompress(comp, size):
+    out = bytearray()
+    i = 0
+    while len(out) < size:
+        flags = comp[i]
+        i += 1
+        for bit in range(8):
+            if len(out) >= size:
+                break
+            if flags & (1 << bit):
+                out.append(comp[i])
+                i += 1
+            else:
+                off = (comp[i] | ((comp[i + 1] >> 4) << 8)) + 1
+                length = (comp[i + 1] & 0x0F) + MIN_MATCH
+                i += 2
+                for _ in range(length):
+                    out.append(out[-off])
+    return bytes(out)
+
+
+def emit(name, comp, raw_size):
+    lines = []
+    for i in range(0, len(comp), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in comp[i:i + 16]) + ",")
+    return (
+        "/**\n"
+        " * @brief LZSS image of %s (%u bytes, %u compressed).\n"
+        " */\n\n"
+        "#define %s_SIZE ((uint32_t)%uU)\n\n"
+        "const uint8_t %s_LZ[] PROGMEM = {\n%s\n};\n"
+        % (name, raw_size, len(comp), name, raw_size, name, "\n".join(lines))
+    )
+
+
+def main():
+    text = open(SRC).read()
+    fw = read_array(text, "VL53L5CX_FIRMWARE")
+    comp = compress(fw)
+    if decompress(comp, len(fw)) != fw:
+        sys.exit("round trip failed: decoded stream differs from VL53L5CX_FIRMWARE")
+    print("VL53L5CX_FIRMWARE: %d -> %d bytes (%.1f%%), round trip OK"
+          % (len(fw), len(comp), 100.0 * len(comp) / len(fw)))
+    if "--check" in sys.argv:
+        return
+
+    with open(DST, "w") as f:
+        f.write(
+            "/* Generated by tools/vl53l5cx_lz.py from vl53l5cx_buffers.h -- do not edit. */\n\n"
+            "#ifndef VL53L5CX_BUFFERS_LZ_H_\n"
+            "#define VL53L5CX_BUFFERS_LZ_H_\n\n"
+            "#include \"platform.h\"\n"
+            "#include <Arduino.h>\n\n"
+        )
+        f.write(emit("VL53L5CX_FIRMWARE", comp, len(fw)))
+        f.write("\n#endif /* VL53L5CX_BUFFERS_LZ_H_ */\n")
+
+
+if __name__ == "__main__":
+    main()